@@ -1,6 +1,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <type_traits>
+#include <algorithm>
 
 #include "CBoard.h"
 
@@ -15,6 +17,10 @@
 
 static char pieces[] = "kqrbnp.PNBRQK";
 
+// Copying the board must be cheap, see COPY_MAKE in ai.cc.
+static_assert(std::is_trivially_copyable<CBoard>::value, "CBoard must be trivially copyable");
+static_assert(sizeof(CBoard) < 200, "CBoard is too large");
+
 
 /***************************************************************
  * operator <<
@@ -27,18 +33,15 @@ std::ostream& operator <<(std::ostream &os, const CBoard &rhs)
         os << TTY_NORM << row << " ";
         for (int col=1; col<=8; ++col)
         {
-            int number = (row+1)*10+col;
+            int number = (row-1)*8+(col-1);
             int piece = rhs.m_board[number];
-            if (piece != IV)
-            {
-                if (piece < 0)
-                    os << TTY_BLUE;
-                else if (piece > 0)
-                    os << TTY_YELLOW;
-                else
-                    os << TTY_NORM;
-                os << pieces[piece+6] << " ";
-            }
+            if (piece < 0)
+                os << TTY_BLUE;
+            else if (piece > 0)
+                os << TTY_YELLOW;
+            else
+                os << TTY_NORM;
+            os << pieces[piece+6] << " ";
         }
         os << std::endl;
     }
@@ -81,25 +84,19 @@ std::ostream& operator <<(std::ostream &os, const CBoard &rhs)
  ***************************************************************/
 void CBoard::newGame()
 {
-    e_piece initial[120] = {
-      IV, IV, IV, IV, IV, IV, IV, IV, IV, IV,
-      IV, IV, IV, IV, IV, IV, IV, IV, IV, IV,
-      IV, WR, WN, WB, WQ, WK, WB, WN, WR, IV,
-      IV, WP, WP, WP, WP, WP, WP, WP, WP, IV,
-      IV, EM, EM, EM, EM, EM, EM, EM, EM, IV,
-      IV, EM, EM, EM, EM, EM, EM, EM, EM, IV,
-      IV, EM, EM, EM, EM, EM, EM, EM, EM, IV,
-      IV, EM, EM, EM, EM, EM, EM, EM, EM, IV,
-      IV, BP, BP, BP, BP, BP, BP, BP, BP, IV,
-      IV, BR, BN, BB, BQ, BK, BB, BN, BR, IV,
-      IV, IV, IV, IV, IV, IV, IV, IV, IV, IV,
-      IV, IV, IV, IV, IV, IV, IV, IV, IV, IV} ;
-
-    m_board.reserve(120);
-    for (int i=0; i<120; ++i)
-    {
-      m_board[i] = initial[i];
-    }
+    e_piece initial[64] = {
+      WR, WN, WB, WQ, WK, WB, WN, WR,
+      WP, WP, WP, WP, WP, WP, WP, WP,
+      EM, EM, EM, EM, EM, EM, EM, EM,
+      EM, EM, EM, EM, EM, EM, EM, EM,
+      EM, EM, EM, EM, EM, EM, EM, EM,
+      EM, EM, EM, EM, EM, EM, EM, EM,
+      BP, BP, BP, BP, BP, BP, BP, BP,
+      BR, BN, BB, BQ, BK, BB, BN, BR} ;
+
+    for (int sq=0; sq<64; ++sq)
+        m_board[sq] = initial[sq];
+    calcBitboards();
 
     m_side_to_move = 1;
 
@@ -113,7 +110,8 @@ void CBoard::newGame()
     m_material = 0;
     m_halfMoves = 0;
     m_fullMoves = 0;
-    m_state.clear();
+    m_hashKey = calcHashKey();
+    calcPst();
 } // end of newGame
 
 
@@ -123,7 +121,7 @@ void CBoard::newGame()
 void CBoard::calcMaterial()
 {
     m_material = 0;
-    for (int i=0; i<120; ++i)
+    for (int i=0; i<64; ++i)
     {
         switch (m_board[i])
         {
@@ -146,14 +144,153 @@ void CBoard::calcMaterial()
 } // end of calcMaterial
 
 
+/**************************************************************
+ * calcPst
+ * Calculates the piece-square score and the game phase from scratch.
+ * During the search, these are updated incrementally in make_move.
+ ***************************************************************/
+void CBoard::calcPst()
+{
+    m_pstMg = 0;
+    m_pstEg = 0;
+    m_phase = 0;
+
+    bitboard_t occ = occupied();
+    while (occ)
+    {
+        int sq = bb_pop(occ);
+        m_pstMg += pst_mg(m_board[sq], sq);
+        m_pstEg += pst_eg(m_board[sq], sq);
+        m_phase += pst_phase(m_board[sq]);
+    }
+} // end of calcPst
+
+
+/**************************************************************
+ * calcHashKey
+ * Calculates the Zobrist hash key from scratch.
+ * During the search, the key is updated incrementally in make_move.
+ ***************************************************************/
+uint64_t CBoard::calcHashKey() const
+{
+    uint64_t key = 0;
+
+    bitboard_t occ = occupied();
+    while (occ)
+    {
+        int sq = bb_pop(occ);
+        key ^= zobrist_piece(m_board[sq], sq);
+    }
+
+    key ^= zobrist_castle(m_castleRights);
+
+    if (m_enPassantSquare)
+        key ^= zobrist_enpassant(m_enPassantSquare);
+
+    if (m_side_to_move > 0)
+        key ^= zobrist_side();
+
+    return key;
+} // end of calcHashKey
+
+
+/***************************************************************
+ * hashKeyDelta
+ * Returns the change of the hash key by the move, i.e. the XOR of
+ * the keys before and after the move. This is the only place,
+ * where the key is updated for a move: make_move applies it, and
+ * hashKeyAfter uses it to predict the key of the child position.
+ ***************************************************************/
+uint64_t CBoard::hashKeyDelta(const CMove& move) const
+{
+    int    from     = move.From();
+    int    to       = move.To();
+    int8_t piece    = m_board[from];
+    int8_t captured = m_board[to];
+    int    up       = (m_side_to_move > 0) ? N : -N;
+
+    uint64_t delta = zobrist_side()
+                   ^ zobrist_piece(piece, from) ^ zobrist_piece(piece, to);
+
+    if (captured != EM)
+        delta ^= zobrist_piece(captured, to);
+    if (move.is_it_a_promotion())
+        delta ^= zobrist_piece(piece, to) ^ zobrist_piece(move.GetPromoted()*m_side_to_move, to);
+    if (move.is_it_en_passant())
+        delta ^= zobrist_piece(-piece, to - up);
+
+    if (move.is_it_castling())
+    {
+        int8_t rook = WR*m_side_to_move;
+        if (to > from) // Castling short
+            delta ^= zobrist_piece(rook, from+3) ^ zobrist_piece(rook, from+1);
+        else           // Castling long
+            delta ^= zobrist_piece(rook, from-4) ^ zobrist_piece(rook, from-1);
+    }
+
+    if (m_enPassantSquare)
+        delta ^= zobrist_enpassant(m_enPassantSquare);
+    if (piece*m_side_to_move == WP && to - from == up+up)
+        delta ^= zobrist_enpassant(from + up);
+
+    // Moving from or to a corner or a king square loses the castling rights there.
+    int lost = m_castleRights & (castleMask(from) | castleMask(to));
+    if (lost)
+        delta ^= zobrist_castle(lost);
+
+    return delta;
+} // end of hashKeyDelta
+
+
+/**************************************************************
+ * calcBitboards
+ * Rebuilds all the bitboards and the king squares from the contents of m_board.
+ ***************************************************************/
+void CBoard::calcBitboards()
+{
+    for (int i=0; i<6; ++i)
+        m_typeBB[i] = 0;
+    m_colorBB[WHITE] = 0;
+    m_colorBB[BLACK] = 0;
+
+    for (int i=0; i<64; ++i)
+    {
+        if (m_board[i] != EM)
+            put_piece(i, m_board[i]);
+        if (m_board[i] == WK)
+            m_kingSquare[WHITE] = i;
+        if (m_board[i] == BK)
+            m_kingSquare[BLACK] = i;
+    }
+} // end of calcBitboards
+
+
 /**************************************************************
  * read_from_fen
  * Sets the board position from a FEN string
- * Returns true on error.
+ * Returns true on error, and then the board is unchanged.
  ***************************************************************/
 bool CBoard::read_from_fen(const char *fen, const char **endptr)
 {
-    unsigned int pos = 91;
+    // The squares are filled in while parsing, so an invalid FEN would
+    // leave them out of step with the bitboards. Parse into a copy.
+    CBoard board(*this);
+    if (board.parse_fen(fen, endptr))
+        return true;
+
+    *this = board;
+    return false;
+} // end of read_from_fen
+
+
+/**************************************************************
+ * parse_fen
+ * Does the work of read_from_fen.
+ ***************************************************************/
+bool CBoard::parse_fen(const char *fen, const char **endptr)
+{
+    unsigned int pos = A8;
+    unsigned int rowEnd = A8 + 8;
     unsigned int strpos = 0;
     enum {st_board, st_sideToMove, st_castling, st_enpassant, st_halfmove, st_fullmove, st_finished}
         state = st_board;
@@ -161,6 +298,8 @@ bool CBoard::read_from_fen(const char *fen, const char **endptr)
     m_castleRights = 0;
     m_side_to_move = 0;
     m_enPassantSquare = 0;
+    m_halfMoves = 0;
+    m_fullMoves = 1;
 
     unsigned int len = strlen(fen);
 
@@ -169,6 +308,10 @@ bool CBoard::read_from_fen(const char *fen, const char **endptr)
         switch (state)
         {
             case st_board :
+                if (pos >= rowEnd && fen[strpos] != '/' && fen[strpos] != ' ')
+                {
+                    return true; // Too many squares in this row
+                }
                 switch (fen[strpos])
                 {
                     case 'k' : m_board[pos++] = BK; break;
@@ -184,11 +327,12 @@ bool CBoard::read_from_fen(const char *fen, const char **endptr)
                     case 'N' : m_board[pos++] = WN; break;
                     case 'P' : m_board[pos++] = WP; break;
                     case '/' :
-                               if ((pos % 10) != 9)
+                               if (pos != rowEnd)
                                {
                                    return true;
                                }
-                               pos -= 18;
+                               rowEnd -= 8;
+                               pos -= 16;
                                break;
                     case '1' :
                     case '2' :
@@ -201,7 +345,7 @@ bool CBoard::read_from_fen(const char *fen, const char **endptr)
                                    int count = fen[strpos] - '0';
                                    while (count > 0)
                                    {
-                                       if ((pos % 10) > 9) 
+                                       if (pos >= rowEnd)
                                        {
                                            return true;
                                        }
@@ -211,7 +355,7 @@ bool CBoard::read_from_fen(const char *fen, const char **endptr)
                                }
                                break;
                     case ' ' :
-                               if (pos != 29)
+                               if (pos != 8)
                                {
                                    return true;
                                }
@@ -257,7 +401,7 @@ bool CBoard::read_from_fen(const char *fen, const char **endptr)
                     case 'e' :
                     case 'f' :
                     case 'g' :
-                    case 'h' : m_enPassantSquare = (fen[strpos] - 'a') + 21; break;
+                    case 'h' : m_enPassantSquare = (fen[strpos] - 'a'); break;
                     case '1' :
                     case '2' :
                     case '3' :
@@ -265,7 +409,7 @@ bool CBoard::read_from_fen(const char *fen, const char **endptr)
                     case '5' :
                     case '6' :
                     case '7' :
-                    case '8' : m_enPassantSquare += (fen[strpos] - '1')*10; break;
+                    case '8' : m_enPassantSquare += (fen[strpos] - '1')*8; break;
                     case ' ' : state = st_halfmove; break;
                     case '-' : break;
                     default  : return true;
@@ -288,6 +432,7 @@ bool CBoard::read_from_fen(const char *fen, const char **endptr)
                         case '8' :
                         case '9' : m_halfMoves = strtol(&fen[strpos], &endp, 10); 
                                    strpos = endp-fen;
+                                   state = st_fullmove;
                                    break;
                         case ' ' : state = st_fullmove; break;
                         default  : state = st_finished; strpos--; break;
@@ -312,6 +457,7 @@ bool CBoard::read_from_fen(const char *fen, const char **endptr)
                         case '8' :
                         case '9' : m_fullMoves = strtol(&fen[strpos], &endp, 10);
                                    strpos = endp-fen;
+                                   state = st_finished;
                                    break;
                         case ' ' : state = st_finished; break;
                         default  : state = st_finished;
@@ -324,6 +470,14 @@ bool CBoard::read_from_fen(const char *fen, const char **endptr)
         } // end of switch
         strpos++;
     } // end of while
+
+    // The move counters are optional, and may end the string,
+    // e.g. in EPD or in "position fen ... w - -".
+    if (state == st_enpassant || state == st_halfmove || state == st_fullmove)
+        state = st_finished;
+    if (strpos > len)
+        strpos = len;
+
     if (state == st_finished &&
             (m_enPassantSquare == 0 || CSquare(m_enPassantSquare).isValid()))
     {
@@ -332,35 +486,49 @@ bool CBoard::read_from_fen(const char *fen, const char **endptr)
 
         }
 
+        // A castling right is only kept, if the king and the rook
+        // are still on their original squares.
+        if (m_board[E1] != WK || m_board[H1] != WR)
+            m_castleRights &= ~CASTLE_WHITE_SHORT;
+        if (m_board[E1] != WK || m_board[A1] != WR)
+            m_castleRights &= ~CASTLE_WHITE_LONG;
+        if (m_board[E8] != BK || m_board[H8] != BR)
+            m_castleRights &= ~CASTLE_BLACK_SHORT;
+        if (m_board[E8] != BK || m_board[A8] != BR)
+            m_castleRights &= ~CASTLE_BLACK_LONG;
+
+        calcBitboards();
         calcMaterial();
+        m_hashKey = calcHashKey();
+        calcPst();
         if (endptr)
             *endptr = &fen[strpos];
         return false;
     }
     return true;
-} // end of read_from_fen
+} // end of parse_fen
 
 
 /***************************************************************
  * readMove
+ * Reads a move in standard algebraic notation (SAN), e.g. "Nbd7",
+ * "exd5", "e8=Q", or "O-O". Returns the invalid move, if the move
+ * is illegal.
  ***************************************************************/
 CMove CBoard::readMove(const char *p, const char **endptr) const
 {
     CMove ret;
 
-    CMoveList moves;
-    find_legal_moves(moves);
-
     // Handle castling
     if (p[0] == 'O' and p[1] == '-' and p[2] == 'O')
     {
         if (m_side_to_move > 0)
         {
-            ret = CMove(WK, E1, G1);
+            ret = CMove(E1, G1, MOVE_CASTLING);
         }
         else
         {
-            ret = CMove(BK, E8, G8);
+            ret = CMove(E8, G8, MOVE_CASTLING);
         }
 
         p+=3;
@@ -369,15 +537,18 @@ CMove CBoard::readMove(const char *p, const char **endptr) const
         {
             if (m_side_to_move > 0)
             {
-                ret = CMove(WK, E1, C1);
+                ret = CMove(E1, C1, MOVE_CASTLING);
             }
             else
             {
-                ret = CMove(BK, E8, C8);
+                ret = CMove(E8, C8, MOVE_CASTLING);
             }
 
             p+=2;
         }
+
+        if (!IsMoveValid(ret))
+            ret = CMove();
     }
     else
     {
@@ -391,8 +562,6 @@ CMove CBoard::readMove(const char *p, const char **endptr) const
             case 'K' : piece = WK; ++p; break;
             default  : break;
         }
-        if (m_side_to_move < 0)
-            piece = -piece;
 
         int disambRow = 0;
         int disambCol = 0;
@@ -428,24 +597,43 @@ CMove CBoard::readMove(const char *p, const char **endptr) const
                 default  : return ret;
             }
         }
-        if (m_side_to_move < 0)
-            promotion = -promotion;
 
-        int numMoves = moves.size();
-        for (int i=0; i<numMoves; ++i)
+        // Only the pieces, that can reach the target square, are
+        // tried. A pawn may capture onto it, or push one or two
+        // squares along the file. IsMoveValid checks the rest.
+        bitboard_t occ        = occupied();
+        bitboard_t target     = bb_square(targetSq);
+        bitboard_t candidates = pieces(piece, (m_side_to_move > 0) ? WHITE : BLACK);
+        switch (piece)
         {
-            ret = moves[i];
-            if (ret.GetPiece() != piece)
-                continue;
-            if (ret.To() != targetSq)
-                continue;
-            if (ret.GetPromoted() != promotion)
-                continue;
-            if (disambCol && disambCol != ret.From().col())
-                continue;
-            if (disambRow && disambRow != ret.From().row())
-                continue;
-            break;
+            case WP :
+                if (m_side_to_move > 0)
+                    candidates &= pawnAttacks[BLACK][targetSq] | (target >> 8) | (target >> 16);
+                else
+                    candidates &= pawnAttacks[WHITE][targetSq] | (target << 8) | (target << 16);
+                break;
+            case WN : candidates &= knightAttacks[targetSq];      break;
+            case WB : candidates &= bishopAttacks(targetSq, occ); break;
+            case WR : candidates &= rookAttacks(targetSq, occ);   break;
+            case WQ : candidates &= queenAttacks(targetSq, occ);  break;
+            case WK : candidates &= kingAttacks[targetSq];        break;
+            default : break;
+        }
+        if (disambCol)
+            candidates &= FILE_A << (disambCol - 1);
+        if (disambRow)
+            candidates &= RANK_1 << (8*(disambRow - 1));
+
+        while (candidates)
+        {
+            int from = bb_pop(candidates);
+            CMove move = promotion ? CMove(from, targetSq, MOVE_PROMOTION, promotion)
+                                   : CMove(from, targetSq);
+            if (IsMoveValid(move))
+            {
+                ret = move;
+                break;
+            }
         }
 
     } // end of if else
@@ -460,6 +648,44 @@ CMove CBoard::readMove(const char *p, const char **endptr) const
 } // end of readMove
 
 
+/***************************************************************
+ * isSquareThreatened
+ * Returns true if the opponent of 'Us' attacks this square.
+ ***************************************************************/
+template <int Us>
+bool CBoard::isSquareThreatened(int sq) const
+{
+    const int Them = Us ^ 1;
+
+    bitboard_t occ = occupied();
+
+    // A pawn of ours on this square would attack exactly the
+    // squares, where an enemy pawn attacks this square from.
+    if (pawnAttacks[Us][sq] & pieces(WP, Them))
+        return true;
+
+    if (knightAttacks[sq] & pieces(WN, Them))
+        return true;
+
+    if (kingAttacks[sq] & pieces(WK, Them))
+        return true;
+
+    // The sliders are only looked up, if one of them is on a line
+    // through this square.
+    bitboard_t queens  = pieces(WQ, Them);
+    bitboard_t bishops = (pieces(WB, Them) | queens) & bishopRays[sq];
+    bitboard_t rooks   = (pieces(WR, Them) | queens) & rookRays[sq];
+
+    if (bishops && (bishopAttacks(sq, occ) & bishops))
+        return true;
+
+    if (rooks && (rookAttacks(sq, occ) & rooks))
+        return true;
+
+    return false;
+} // end of isSquareThreatened
+
+
 /***************************************************************
  * isSquareThreatened
  * Returns true if OTHER side to move threatens this square
@@ -467,913 +693,714 @@ CMove CBoard::readMove(const char *p, const char **endptr) const
 bool CBoard::isSquareThreatened(const CSquare& sq) const
 {
     if (m_side_to_move > 0)
-    {
-        // Check for pawns
-        if (m_board[sq + NW] == BP || m_board[sq + NE] == BP)
-            return true;
+        return isSquareThreatened<WHITE>(sq);
+    else
+        return isSquareThreatened<BLACK>(sq);
+} // end of isSquareThreatened
 
-        // Check for knigts
-        {
-            int dirs[8] = {NNW, NNE, NWW, NEE, SSW, SSE, SWW, SEE};
 
-            for (int k=0; k<8; ++k)
-            {
-                int dir = dirs[k];
-                if (m_board[sq + dir] == BN)
-                    return true;
-            }
-        }
+/***************************************************************
+ * attackersTo
+ * Returns all pieces (of either colour) that attack this square,
+ * when the board occupancy is 'occ'.
+ ***************************************************************/
+bitboard_t CBoard::attackersTo(int sq, bitboard_t occ) const
+{
+    bitboard_t queens  = m_typeBB[WQ-1];
+    bitboard_t bishops = (m_typeBB[WB-1] | queens) & bishopRays[sq];
+    bitboard_t rooks   = (m_typeBB[WR-1] | queens) & rookRays[sq];
 
-        // Check for diagonal (bishop and queen)
-        {
-            int dirs[4] = {NW, NE, SW, SE};
+    bitboard_t attackers = (pawnAttacks[WHITE][sq] & pieces(WP, BLACK))
+                         | (pawnAttacks[BLACK][sq] & pieces(WP, WHITE))
+                         | (knightAttacks[sq]      & m_typeBB[WN-1])
+                         | (kingAttacks[sq]        & m_typeBB[WK-1]);
 
-            for (int k=0; k<4; ++k)
-            {
-                int dir = dirs[k];
-                int sq2 = sq;
-                while (1)
-                {
-                    sq2 += dir;
-                    if (m_board[sq2] == BB || m_board[sq2] == BQ)
-                        return true;
-                    if (m_board[sq2] != EM)
-                        break;
-                }
+    // Skip the sliders that can not reach this square on any board.
+    if (bishops)
+        attackers |= bishopAttacks(sq, occ) & bishops;
+    if (rooks)
+        attackers |= rookAttacks(sq, occ) & rooks;
 
-            }
-        }
+    return attackers;
+} // end of attackersTo
 
-        // Check for horizontal/vertical (rook and queen)
-        {
-            int dirs[4] = {N, S, W, E};
 
-            for (int k=0; k<4; ++k)
-            {
-                int dir = dirs[k];
-                int sq2 = sq;
-                while (1)
-                {
-                    sq2 += dir;
-                    if (m_board[sq2] == BR || m_board[sq2] == BQ)
-                        return true;
-                    if (m_board[sq2] != EM)
-                        break;
-                }
+/***************************************************************
+ * attackedBy
+ * Returns all squares attacked by the given side, when the board
+ * occupancy is 'occ'. All the sliders are handled at once, see
+ * sliderAttacks in bitboard.h.
+ ***************************************************************/
+template <int Color>
+bitboard_t CBoard::attackedBy(bitboard_t occ) const
+{
+    const int up = (Color == WHITE) ? N : S;
 
-            }
-        }
+    bitboard_t pawns   = pieces(WP, Color);
+    bitboard_t queens  = pieces(WQ, Color);
+    bitboard_t attacks = bb_shift<up+W>(pawns & ~FILE_A)
+                       | bb_shift<up+E>(pawns & ~FILE_H)
+                       | kingAttacks[m_kingSquare[Color]]
+                       | sliderAttacks(pieces(WR, Color) | queens, pieces(WB, Color) | queens, occ);
 
-        // Check for king
-        {
-            int dirs[8] = {NW, NE, SW, SE, N, S, W, E};
+    bitboard_t knights = pieces(WN, Color);
+    while (knights)
+        attacks |= knightAttacks[bb_pop(knights)];
 
-            for (int k=0; k<8; ++k)
-            {
-                int dir = dirs[k];
-                if (m_board[sq + dir] == BK)
-                    return true;
-            }
-        }
-    }
-    else
-    {
-        // Check for pawns
-        if (m_board[sq + SW] == WP || m_board[sq + SE] == WP)
-            return true;
+    return attacks;
+} // end of attackedBy
 
-        // Check for knigts
-        {
-            int dirs[8] = {NNW, NNE, NWW, NEE, SSW, SSE, SWW, SEE};
 
-            for (int k=0; k<8; ++k)
-            {
-                int dir = dirs[k];
-                if (m_board[sq + dir] == WN)
-                    return true;
-            }
-        }
+/***************************************************************
+ * see
+ * Static Exchange Evaluation.
+ * Returns the material won (in centipawns) by the capture, when both
+ * sides keep recapturing on the target square with their least
+ * valuable piece, and each side may stop when that is better.
+ * Sliders behind the capturing pieces (x-rays) are included,
+ * because the attackers are recalculated after each capture.
+ * Pins are ignored.
+ ***************************************************************/
+int CBoard::see(const CMove &move) const
+{
+    static const int value[7] = {0, 100, 300, 300, 500, 900, 10000};
 
-        // Check for diagonal (bishop and queen)
-        {
-            int dirs[4] = {NW, NE, SW, SE};
+    int to    = move.To();
+    int side  = (m_board[move.From()] > 0) ? WHITE : BLACK;
+    int piece = abs(m_board[move.From()]);
 
-            for (int k=0; k<4; ++k)
-            {
-                int dir = dirs[k];
-                int sq2 = sq;
-                while (1)
-                {
-                    sq2 += dir;
-                    if (m_board[sq2] == WB || m_board[sq2] == WQ)
-                        return true;
-                    if (m_board[sq2] != EM)
-                        break;
-                }
+    bitboard_t occ    = occupied();
+    bitboard_t fromBB = bb_square(move.From());
 
-            }
-        }
+    int gain[32];
+    int d = 0;
+    gain[0] = value[abs(m_board[to])];
+    if (move.is_it_en_passant())
+    {
+        gain[0] = value[WP];
+        occ ^= bb_square(m_enPassantSquare + ((side == WHITE) ? S : N));
+    }
 
-        // Check for horizontal/vertical (rook and queen)
-        {
-            int dirs[4] = {N, S, W, E};
+    while (d < 31)
+    {
+        // The gain, if the piece now on the target square is captured.
+        d++;
+        gain[d] = value[piece] - gain[d-1];
 
-            for (int k=0; k<4; ++k)
-            {
-                int dir = dirs[k];
-                int sq2 = sq;
-                while (1)
-                {
-                    sq2 += dir;
-                    if (m_board[sq2] == WR || m_board[sq2] == WQ)
-                        return true;
-                    if (m_board[sq2] != EM)
-                        break;
-                }
+        occ  ^= fromBB;
+        side ^= 1;
 
-            }
-        }
+        bitboard_t attackers = attackersTo(to, occ) & occ & m_colorBB[side];
+        if (!attackers)
+            break;
 
-        // Check for king
+        // Find the least valuable attacker.
+        for (piece=WP; piece<=WK; ++piece)
         {
-            int dirs[8] = {NW, NE, SW, SE, N, S, W, E};
-
-            for (int k=0; k<8; ++k)
+            bitboard_t bb = attackers & m_typeBB[piece-1];
+            if (bb)
             {
-                int dir = dirs[k];
-                if (m_board[sq + dir] == WK)
-                    return true;
+                fromBB = bb & -bb;
+                break;
             }
         }
     }
 
-    return false;
-} // end of isSquareThreatened
+    // Each side may choose not to recapture.
+    while (--d)
+        gain[d-1] = -std::max(-gain[d-1], gain[d]);
+
+    return gain[0];
+} // end of see
 
 
 /***************************************************************
- * find_legal_moves
- * This generates a complete list of all pseudo-legal moves.
- * A pseudo-legal move does not consider, whether the king will
- * be in check. This is handled else-where.
+ * add_pawn_moves
+ * Adds the moves of all pawns arriving at the squares in 'targets'.
+ * 'dir' is the distance moved, so the origin is 'to - dir'.
+ * Moves to the last row are expanded into all four promotions.
  ***************************************************************/
-void CBoard::find_legal_moves(CMoveList &moves) const
+static void add_pawn_moves(CMoveList &moves, bitboard_t targets, int dir)
 {
-    moves.clear();
+    while (targets)
+    {
+        int to   = bb_pop(targets);
+        int from = to - dir;
 
-    if (m_side_to_move > 0)
-        for (int i=A1; i<=H8; ++i)
+        if (to >= A8 || to <= H1)
         {
-            int8_t piece = m_board[i];
-            int j;
+            moves.push_back(CMove(from, to, MOVE_PROMOTION, WQ));
+            moves.push_back(CMove(from, to, MOVE_PROMOTION, WR));
+            moves.push_back(CMove(from, to, MOVE_PROMOTION, WB));
+            moves.push_back(CMove(from, to, MOVE_PROMOTION, WN));
+        }
+        else
+        {
+            moves.push_back(CMove(from, to));
+        }
+    }
+} // end of add_pawn_moves
 
-            switch (piece)
-            {
-                case WP : 
-                    j = i + 10;
-                    if (m_board[j] == EM)
-                    {
-                        if (i > 80)
-                        {
-                            {
-                                CMove move(piece, i, j, EM, WQ);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, EM, WR);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, EM, WB);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, EM, WN);
-                                moves.push_back(move);
-                            }
-                        }
-                        else
-                        {
-                            CMove move(piece, i, j, EM);
-                            moves.push_back(move);
-                        }
-
-                        j = i + 20;
-                        if (m_board[j] == EM)
-                        {
-                            if (i < 40)
-                            {
-                                CMove move(piece, i, j, EM);
-                                moves.push_back(move);
-                            }
-                        }
-                    }
 
-                    j = i + 9;
-                    if ((m_board[j] != IV && m_board[j] < 0) || j == m_enPassantSquare)
-                    {
-                        if (i > 80)
-                        {
-                            {
-                                CMove move(piece, i, j, m_board[j], WQ);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], WR);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], WB);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], WN);
-                                moves.push_back(move);
-                            }
-                        }
-                        else
-                        {
-                            CMove move(piece, i, j, m_board[j]);
-                            moves.push_back(move);
-                        }
-                    }
+/***************************************************************
+ * find_pawn_moves
+ * Adds all pushes and captures of the given pawns, where the
+ * destination square is in 'mask'. En-passant is handled elsewhere.
+ * The pawns are moved all at once, by shifting the entire bitboard.
+ ***************************************************************/
+template <int Us>
+void CBoard::find_pawn_moves(CMoveList &moves, bitboard_t pawns, bitboard_t mask) const
+{
+    const int        up    = (Us == WHITE) ? N : S;
+    const bitboard_t rank3 = (Us == WHITE) ? RANK_3 : RANK_6;
 
-                    j = i + 11;
-                    if ((m_board[j] != IV && m_board[j] < 0) || j == m_enPassantSquare)
-                    {
-                        if (i > 80)
-                        {
-                            {
-                                CMove move(piece, i, j, m_board[j], WQ);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], WR);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], WB);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], WN);
-                                moves.push_back(move);
-                            }
-                        }
-                        else
-                        {
-                            CMove move(piece, i, j, m_board[j]);
-                            moves.push_back(move);
-                        }
-                    }
-                    break;
+    bitboard_t empty  = ~occupied();
+    bitboard_t enemy  = m_colorBB[Us ^ 1] & mask;
+    bitboard_t single = bb_shift<up>(pawns) & empty;
+    bitboard_t twice  = bb_shift<up>(single & rank3) & empty;
 
-                case WN : 
-                    {
-                        int dirs[8] = {NNW, NNE, NWW, NEE, SSW, SSE, SWW, SEE};
-
-                        for (int k=0; k<8; ++k)
-                        {
-                            int dir = dirs[k];
-
-                            j = i+dir;
-                            if (m_board[j] != IV) 
-                                if (m_board[j] <= 0)
-                                {
-                                    CMove move(piece, i, j, m_board[j]);
-                                    moves.push_back(move);
-                                }
-                        }
-                    }
+    add_pawn_moves(moves, single & mask, up);
+    add_pawn_moves(moves, twice & mask, up+up);
+    add_pawn_moves(moves, bb_shift<up+W>(pawns & ~FILE_A) & enemy, up+W);
+    add_pawn_moves(moves, bb_shift<up+E>(pawns & ~FILE_H) & enemy, up+E);
+} // end of find_pawn_moves
 
-                    break;
 
-                case WB : 
-                    {
-                        int dirs[4] = {NW, NE, SW, SE};
-
-                        for (int k=0; k<4; ++k)
-                        {
-                            int dir = dirs[k];
-                            j = i;
-                            while (1)
-                            {
-                                j += dir;
-                                if (m_board[j] == IV) break;
-                                if (m_board[j] <= 0)
-                                {
-                                    CMove move(piece, i, j, m_board[j]);
-                                    moves.push_back(move);
-                                    if (m_board[j] < 0)
-                                        break;
-                                }
-                                else
-                                    break;
-                            }
-                        }
-                    }
+/***************************************************************
+ * find_moves
+ * This generates a list of legal moves.
+ * Rather than trying each move and testing whether the king is
+ * left in check, the checking pieces and the pinned pieces are
+ * found first, and the moves of each piece are restricted
+ * accordingly.
+ *
+ * GenType selects captures, non-captures, or both.
+ * Promotions count as captures, because they change the material.
+ * Only moves to a square in 'targets' are generated.
+ ***************************************************************/
+template <int Us, int GenType>
+void CBoard::find_moves(CMoveList &moves, bitboard_t targets) const
+{
+    const int Them = Us ^ 1;
+    const int flip = (Us == WHITE) ? 0 : 56; // Mirrors the first row to the last
 
-                    break;
+    moves.clear();
 
-                case WR : 
-                    {
-                        int dirs[4] = {N, W, S, E};
-
-                        for (int k=0; k<4; ++k)
-                        {
-                            int dir = dirs[k];
-                            j = i;
-                            while (1)
-                            {
-                                j += dir;
-                                if (m_board[j] == IV) break;
-                                if (m_board[j] <= 0)
-                                {
-                                    CMove move(piece, i, j, m_board[j]);
-                                    moves.push_back(move);
-                                    if (m_board[j] < 0)
-                                        break;
-                                }
-                                else
-                                    break;
-                            }
-                        }
-                    }
+    bitboard_t occ   = occupied();
+    bitboard_t own   = m_colorBB[Us];
+    bitboard_t enemy = m_colorBB[Them];
+    int        ksq   = m_kingSquare[Us];
 
-                    break;
+    bitboard_t checkers = attackersTo(ksq, occ) & enemy;
 
-                case WQ : 
-                    {
-                        int dirs[8] = {N, W, S, E, NW, NE, SW, SE};
-
-                        for (int k=0; k<8; ++k)
-                        {
-                            int dir = dirs[k];
-                            j = i;
-                            while (1)
-                            {
-                                j += dir;
-                                if (m_board[j] == IV) break;
-                                if (m_board[j] <= 0)
-                                {
-                                    CMove move(piece, i, j, m_board[j]);
-                                    moves.push_back(move);
-                                    if (m_board[j] < 0)
-                                        break;
-                                }
-                                else
-                                    break;
-                            }
-                        }
-                    }
+    // Pawn pushes to the last row are promotions, and are
+    // generated together with the captures, not the quiet moves.
+    bitboard_t promotions  = (RANK_1 | RANK_8) & ~occ;
+    bitboard_t pawnTargets = targets;
+    bool       enPassant   = m_enPassantSquare && (GenType & GEN_CAPTURES)
+                             && (targets & bb_square(m_enPassantSquare));
 
-                    break;
+    if (!(GenType & GEN_CAPTURES))
+    {
+        targets     &= ~enemy;
+        pawnTargets &= ~enemy & ~promotions;
+    }
+    if (!(GenType & GEN_QUIETS))
+    {
+        targets     &= enemy;
+        pawnTargets &= enemy | promotions;
+    }
 
-                case WK : 
-                    {
-                        int dirs[8] = {N, W, S, E, NW, NE, SW, SE};
-
-                        for (int k=0; k<8; ++k)
-                        {
-                            int dir = dirs[k];
-
-                            j = i+dir;
-                            if (m_board[j] != IV) 
-                                if (m_board[j] <= 0)
-                                {
-                                    CMove move(piece, i, j, m_board[j]);
-                                    moves.push_back(move);
-                                }
-                        }
-
-                        if (m_castleRights & CASTLE_WHITE_SHORT)
-                        { // Then King and Rook must be in place
-                            if (m_board[F1] == EM && m_board[G1] == EM)
-                            {
-                                if (!isSquareThreatened(E1) && !isSquareThreatened(F1))
-                                {
-                                    CMove move(WK, E1, G1);
-                                    moves.push_back(move);
-                                }
-                            }
-                        }
-                        if (m_castleRights & CASTLE_WHITE_LONG)
-                        { // Then King and Rook must be in place
-                            if (m_board[B1] == EM && m_board[C1] == EM && m_board[D1] == EM)
-                            {
-                                if (!isSquareThreatened(E1) && !isSquareThreatened(D1))
-                                {
-                                    CMove move(WK, E1, C1);
-                                    moves.push_back(move);
-                                }
-                            }
-                        }
-                    }
+    // King moves. The king is removed from the board first, so that
+    // it does not shield the squares behind it from a slider.
+    // The attacked squares are also used for castling below.
+    bitboard_t kingTargets = kingAttacks[ksq] & ~own & targets;
+    bitboard_t danger      = 0;
+    if (kingTargets || (GenType & GEN_QUIETS))
+    {
+        danger = attackedBy<Them>(occ ^ bb_square(ksq));
+        kingTargets &= ~danger;
+        while (kingTargets)
+            moves.push_back(CMove(ksq, bb_pop(kingTargets)));
+    }
 
-                    break;
+    // In double check, only the king can move.
+    if (checkers & (checkers - 1))
+        return;
 
-                default : // Invalid, wrong color, or empty
-                    continue;
-            }
+    // In single check, the other pieces must either capture the
+    // checking piece or move in between it and the king.
+    bitboard_t mask     = ~own & targets;
+    bitboard_t pawnMask = ~own & pawnTargets;
+    if (checkers)
+    {
+        mask     &= betweenBB[ksq][bb_first(checkers)] | checkers;
+        pawnMask &= betweenBB[ksq][bb_first(checkers)] | checkers;
+    }
 
+    // A piece is pinned, if it is the only piece between the king
+    // and an enemy slider. It may only move along that line.
+    bitboard_t pinned = 0;
+    {
+        bitboard_t queens  = pieces(WQ, Them);
+        bitboard_t snipers = (rookRays[ksq]   & (pieces(WR, Them) | queens))
+                           | (bishopRays[ksq] & (pieces(WB, Them) | queens));
+        while (snipers)
+        {
+            bitboard_t between = betweenBB[ksq][bb_pop(snipers)] & occ;
+            if (between && !(between & (between - 1)))
+                pinned |= between & own;
         }
+    }
 
-    else
-        for (int i=A1; i<=H8; ++i)
+    // Pawns
+    {
+        bitboard_t pawns = pieces(WP, Us);
+        find_pawn_moves<Us>(moves, pawns & ~pinned, pawnMask);
+
+        bitboard_t pinnedPawns = pawns & pinned;
+        while (pinnedPawns)
         {
-            int8_t piece = m_board[i];
-            int j;
+            int from = bb_pop(pinnedPawns);
+            find_pawn_moves<Us>(moves, bb_square(from), pawnMask & lineBB[ksq][from]);
+        }
 
-            switch (piece)
+        // En-passant may expose the king along the row of both pawns,
+        // so these few moves are verified by removing both pawns.
+        if (enPassant)
+        {
+            int capsq = m_enPassantSquare + ((Us == WHITE) ? S : N);
+            bitboard_t candidates = pawnAttacks[Them][m_enPassantSquare] & pawns;
+            while (candidates)
             {
-                case BP : 
-                    j = i - 10;
-                    if (m_board[j] == EM)
-                    {
-                        if (i < 40)
-                        {
-                            {
-                                CMove move(piece, i, j, EM, BQ);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, EM, BR);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, EM, BB);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, EM, BN);
-                                moves.push_back(move);
-                            }
-                        }
-                        else
-                        {
-                            CMove move(piece, i, j, EM);
-                            moves.push_back(move);
-                        }
-
-                        j = i - 20;
-                        if (m_board[j] == EM)
-                        {
-                            if (i > 80)
-                            {
-                                CMove move(piece, i, j, EM);
-                                moves.push_back(move);
-                            }
-                        }
-                    }
-
-                    j = i - 9;
-                    if ((m_board[j] != IV && m_board[j] > 0) || j == m_enPassantSquare)
-                    {
-                        if (i < 40)
-                        {
-                            {
-                                CMove move(piece, i, j, m_board[j], BQ);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], BR);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], BB);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], BN);
-                                moves.push_back(move);
-                            }
-                        }
-                        else
-                        {
-                            CMove move(piece, i, j, m_board[j]);
-                            moves.push_back(move);
-                        }
-                    }
-
-                    j = i - 11;
-                    if ((m_board[j] != IV && m_board[j] > 0) || j == m_enPassantSquare)
-                    {
-                        if (i < 40)
-                        {
-                            {
-                                CMove move(piece, i, j, m_board[j], BQ);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], BR);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], BB);
-                                moves.push_back(move);
-                            }
-                            {
-                                CMove move(piece, i, j, m_board[j], BN);
-                                moves.push_back(move);
-                            }
-                        }
-                        else
-                        {
-                            CMove move(piece, i, j, m_board[j]);
-                            moves.push_back(move);
-                        }
-                    }
-                    break;
-
-                case BN : 
-                    {
-                        int dirs[8] = {NNW, NNE, NWW, NEE, SSW, SSE, SWW, SEE};
-
-                        for (int k=0; k<8; ++k)
-                        {
-                            int dir = dirs[k];
-
-                            j = i+dir;
-                            if (m_board[j] != IV) 
-                                if (m_board[j] >= 0)
-                                {
-                                    CMove move(piece, i, j, m_board[j]);
-                                    moves.push_back(move);
-                                }
-                        }
-                    }
-
-                    break;
-
-                case BB : 
-                    {
-                        int dirs[4] = {NE, NW, SE, SW};
-
-                        for (int k=0; k<4; ++k)
-                        {
-                            int dir = dirs[k];
-                            j = i;
-                            while (1)
-                            {
-                                j += dir;
-                                if (m_board[j] == IV) break;
-                                if (m_board[j] >= 0)
-                                {
-                                    CMove move(piece, i, j, m_board[j]);
-                                    moves.push_back(move);
-                                    if (m_board[j] > 0)
-                                        break;
-                                }
-                                else
-                                    break;
-                            }
-                        }
-                    }
+                int from = bb_pop(candidates);
+                bitboard_t occAfter = (occ ^ bb_square(from) ^ bb_square(capsq))
+                                    | bb_square(m_enPassantSquare);
+                if (!(attackersTo(ksq, occAfter) & enemy & ~bb_square(capsq)))
+                    moves.push_back(CMove(from, m_enPassantSquare, MOVE_EN_PASSANT));
+            }
+        }
+    }
 
-                    break;
+    // Knights, bishops, rooks, and queens.
+    for (int type=WN; type<=WQ; ++type)
+    {
+        bitboard_t bb = pieces(type, Us);
 
-                case BR : 
-                    {
-                        int dirs[4] = {N, W, S, E};
-
-                        for (int k=0; k<4; ++k)
-                        {
-                            int dir = dirs[k];
-                            j = i;
-                            while (1)
-                            {
-                                j += dir;
-                                if (m_board[j] == IV) break;
-                                if (m_board[j] >= 0)
-                                {
-                                    CMove move(piece, i, j, m_board[j]);
-                                    moves.push_back(move);
-                                    if (m_board[j] > 0)
-                                        break;
-                                }
-                                else
-                                    break;
-                            }
-                        }
-                    }
+        while (bb)
+        {
+            int from = bb_pop(bb);
+            bitboard_t attacks;
 
-                    break;
+            switch (type)
+            {
+                case WN : attacks = knightAttacks[from];       break;
+                case WB : attacks = bishopAttacks(from, occ);  break;
+                case WR : attacks = rookAttacks(from, occ);    break;
+                default : attacks = queenAttacks(from, occ);   break;
+            }
 
-                case BQ : 
-                    {
-                        int dirs[8] = {N, W, S, E, NW, SW, NE, SE};
-
-                        for (int k=0; k<8; ++k)
-                        {
-                            int dir = dirs[k];
-                            j = i;
-                            while (1)
-                            {
-                                j += dir;
-                                if (m_board[j] == IV) break;
-                                if (m_board[j] >= 0)
-                                {
-                                    CMove move(piece, i, j, m_board[j]);
-                                    moves.push_back(move);
-                                    if (m_board[j] > 0)
-                                        break;
-                                }
-                                else
-                                    break;
-                            }
-                        }
-                    }
+            attacks &= mask;
+            if (pinned & bb_square(from))
+                attacks &= lineBB[ksq][from];
 
-                    break;
+            while (attacks)
+            {
+                int to = bb_pop(attacks);
+                moves.push_back(CMove(from, to));
+            }
+        }
+    }
 
-                case BK : 
-                    {
-                        int dirs[8] = {N, W, S, E, NW, SW, NE, SE};
-
-                        for (int k=0; k<8; ++k)
-                        {
-                            int dir = dirs[k];
-
-                            j = i+dir;
-                            if (m_board[j] != IV) 
-                                if (m_board[j] >= 0)
-                                {
-                                    CMove move(piece, i, j, m_board[j]);
-                                    moves.push_back(move);
-                                }
-                        }
-
-                        if (m_castleRights & CASTLE_BLACK_SHORT)
-                        { // Then King and Rook must be in place
-                            if (m_board[F8] == EM && m_board[G8] == EM)
-                            {
-                                if (!isSquareThreatened(E8) && !isSquareThreatened(F8))
-                                {
-                                    CMove move(BK, E8, G8);
-                                    moves.push_back(move);
-                                }
-                            }
-                        }
-                        if (m_castleRights & CASTLE_BLACK_LONG)
-                        { // Then King and Rook must be in place
-                            if (m_board[B8] == EM && m_board[C8] == EM && m_board[D8] == EM)
-                            {
-                                if (!isSquareThreatened(E8) && !isSquareThreatened(D8))
-                                {
-                                    CMove move(BK, E8, C8);
-                                    moves.push_back(move);
-                                }
-                            }
-                        }
-                    }
+    // Castling. The king may not castle out of, through, or into check.
+    // Removing the king above does not matter here, because a slider
+    // behind the king would give check.
+    if (checkers || !(GenType & GEN_QUIETS))
+        return;
 
-                    break;
+    const int castleShort = (Us == WHITE) ? CASTLE_WHITE_SHORT : CASTLE_BLACK_SHORT;
+    const int castleLong  = (Us == WHITE) ? CASTLE_WHITE_LONG  : CASTLE_BLACK_LONG;
 
-                default : // Invalid, wrong color, or empty
-                    continue;
+    if ((m_castleRights & castleShort) && (targets & bb_square(G1^flip)))
+    { // Then King and Rook must be in place
+        if (m_board[F1^flip] == EM && m_board[G1^flip] == EM)
+        {
+            if (!(danger & (bb_square(F1^flip) | bb_square(G1^flip))))
+            {
+                CMove move(E1^flip, G1^flip, MOVE_CASTLING);
+                moves.push_back(move);
+            }
+        }
+    }
+    if ((m_castleRights & castleLong) && (targets & bb_square(C1^flip)))
+    { // Then King and Rook must be in place
+        if (m_board[B1^flip] == EM && m_board[C1^flip] == EM && m_board[D1^flip] == EM)
+        {
+            if (!(danger & (bb_square(D1^flip) | bb_square(C1^flip))))
+            {
+                CMove move(E1^flip, C1^flip, MOVE_CASTLING);
+                moves.push_back(move);
             }
+        }
+    }
+} // end of find_moves
 
+
+/***************************************************************
+ * find_moves
+ * Selects the generator for the side to move and the move type.
+ * This is the only place, where the side to move is tested.
+ ***************************************************************/
+void CBoard::find_moves(CMoveList &moves, int genType, bitboard_t targets) const
+{
+    if (m_side_to_move > 0)
+    {
+        switch (genType)
+        {
+            case GEN_CAPTURES : find_moves<WHITE, GEN_CAPTURES>(moves, targets); break;
+            case GEN_QUIETS   : find_moves<WHITE, GEN_QUIETS>(moves, targets);   break;
+            default           : find_moves<WHITE, GEN_ALL>(moves, targets);      break;
+        }
+    }
+    else
+    {
+        switch (genType)
+        {
+            case GEN_CAPTURES : find_moves<BLACK, GEN_CAPTURES>(moves, targets); break;
+            case GEN_QUIETS   : find_moves<BLACK, GEN_QUIETS>(moves, targets);   break;
+            default           : find_moves<BLACK, GEN_ALL>(moves, targets);      break;
         }
-} // end of void CBoard::find_legal_moves(CMoveList &moves) const;
+    }
+} // end of find_moves
 
 
 /***************************************************************
  * make_move
- * This updates the board according to the move
+ * This updates the board according to the move.
+ * 'Us' is the side to move, so the colour of every piece involved
+ * is known, and the squares of the king and the rooks are those
+ * of White, mirrored for Black.
  ***************************************************************/
-void CBoard::make_move(const CMove &move)
+template <int Us>
+void CBoard::make_move(const CMove &move, t_undo &undo)
 {
-    m_state.push_back((m_enPassantSquare << 8) | m_castleRights);
+    const int8_t sign = (Us == WHITE) ? 1 : -1;
+    const int    up   = (Us == WHITE) ? N : S;
+    const int    flip = (Us == WHITE) ? 0 : 56;
+
+    int    from     = move.From();
+    int    to       = move.To();
+    int8_t piece    = m_board[from];
+    int8_t captured = m_board[to];
+
+    // Save everything that can not be reversed.
+    undo.material        = m_material;
+    undo.halfMoves       = m_halfMoves;
+    undo.captured        = captured;
+    undo.castleRights    = m_castleRights;
+    undo.enPassantSquare = m_enPassantSquare;
+    undo.hashKey         = m_hashKey;
+    undo.pstMg           = m_pstMg;
+    undo.pstEg           = m_pstEg;
+    undo.phase           = m_phase;
+
+    // The hash key is updated in one go, before the board changes.
+    // The piece-square score is updated along with the board.
+    m_hashKey ^= hashKeyDelta(move);
+
     m_enPassantSquare = 0;
-    switch (move.GetCaptured())
+
+    // The 50-move rule counts moves since the last capture or pawn move.
+    m_halfMoves++;
+    if (captured != EM || piece == WP*sign)
+        m_halfMoves = 0;
+
+    // The captured piece is always the opponent's.
+    switch (-captured*sign)
     {
-        case WP : case BP : m_material += 1; break;
-        case WN : case BN : m_material += 3; break;
-        case WB : case BB : m_material += 3; break;
-        case WR : case BR : m_material += 5; break;
-        case WQ : case BQ : m_material += 9; break;
+        case WP : m_material += 1; break;
+        case WN : m_material += 3; break;
+        case WB : m_material += 3; break;
+        case WR : m_material += 5; break;
+        case WQ : m_material += 9; break;
         default : break;
     }
 
     switch (move.GetPromoted())
     {
-        case WN : case BN : m_material += 3-1; break;
-        case WB : case BB : m_material += 3-1; break;
-        case WR : case BR : m_material += 5-1; break;
-        case WQ : case BQ : m_material += 9-1; break;
+        case WN : m_material += 3-1; break;
+        case WB : m_material += 3-1; break;
+        case WR : m_material += 5-1; break;
+        case WQ : m_material += 9-1; break;
         default : break;
     }
 
-    // If rook is captured, then update castling rights.
-    switch (move.GetCaptured())
-    {
-        case WR :
-            if (move.To() == H1)
-                m_castleRights &= ~CASTLE_WHITE_SHORT;
-            if (move.To() == A1)
-                m_castleRights &= ~CASTLE_WHITE_LONG;
-            break;
-        case BR :
-            if (move.To() == H8)
-                m_castleRights &= ~CASTLE_BLACK_SHORT;
-            if (move.To() == A8)
-                m_castleRights &= ~CASTLE_BLACK_LONG;
-            break;
-        default : break;
-    }
+    // A move from or to the square of a king or a rook, that may
+    // still castle, loses the rights. This includes the capture of
+    // a rook. The same rule updates the key in hashKeyDelta.
+    m_castleRights &= ~(castleMask(from) | castleMask(to));
 
-    switch (m_board[move.From()])
+    switch (piece*sign)
     {
         case WK :
-            if (move.From() == E1 &&
-                    move.To() == G1) // White castling short
-            {
-                m_board[H1] = EM;
-                m_board[F1] = WR;
-            }
-            else if (move.From() == E1 &&
-                    move.To() == C1 ) // White castling long
+            if (move.is_it_castling())
             {
-                m_board[A1] = EM;
-                m_board[D1] = WR;
+                if (to == (G1^flip)) // Castling short
+                {
+                    move_piece(H1^flip, F1^flip);
+                    incr_remove(WR*sign, H1^flip);
+                    incr_add(WR*sign, F1^flip);
+                }
+                else                 // Castling long
+                {
+                    move_piece(A1^flip, D1^flip);
+                    incr_remove(WR*sign, A1^flip);
+                    incr_add(WR*sign, D1^flip);
+                }
             }
 
-            m_castleRights &= ~(CASTLE_WHITE_SHORT | CASTLE_WHITE_LONG);
+            m_kingSquare[Us] = to;
             break;
 
-        case BK :
-            if (move.From() == E8 &&
-                    move.To() == G8) // Black castling short
+        case WP :
+            if (to - from == up+up) // Double pawn move
             {
-                m_board[H8] = EM;
-                m_board[F8] = BR;
+                m_enPassantSquare = from + up;
             }
-            else if (move.From() == E8 &&
-                    move.To() == C8) // Black castling long
+            else if (move.is_it_en_passant())
             {
-                m_board[A8] = EM;
-                m_board[D8] = BR;
+                remove_piece(to - up);
+                incr_remove(-WP*sign, to - up);
+                m_material += 1;
             }
-
-            m_castleRights &= ~(CASTLE_BLACK_SHORT | CASTLE_BLACK_LONG);
             break;
 
-        case WR :
-            if (move.From() == H1) // White moves king rook
-            {
-                m_castleRights &= ~(CASTLE_WHITE_SHORT);
-            }
-            else if (move.From() == A1) // White moves queen rook
-            {
-                m_castleRights &= ~(CASTLE_WHITE_LONG);
-            }
+        default :
             break;
+    } // end of switch
+
+    if (captured != EM)
+    {
+        remove_piece(to);
+        incr_remove(captured, to);
+    }
+    move_piece(from, to);
+    incr_remove(piece, from);
+    if (move.is_it_a_promotion())
+    {
+        piece = move.GetPromoted() * sign;
+        remove_piece(to);
+        put_piece(to, piece);
+    }
+    incr_add(piece, to);
+
+    m_side_to_move = -m_side_to_move;
+    m_material = -m_material;
+} // end of make_move
 
-        case BR :
-            if (move.From() == H8) // Black moves king rook
-            {
-                m_castleRights &= ~(CASTLE_BLACK_SHORT);
-            }
-            else if (move.From() == A8) // Black moves queen rook
-            {
-                m_castleRights &= ~(CASTLE_BLACK_LONG);
-            }
-            break;
 
+/***************************************************************
+ * make_move
+ * This updates the board according to the move
+ ***************************************************************/
+void CBoard::make_move(const CMove &move, t_undo &undo)
+{
+    if (m_side_to_move > 0)
+        make_move<WHITE>(move, undo);
+    else
+        make_move<BLACK>(move, undo);
+} // end of void CBoard::make_move(const CMove &move, t_undo &undo)
+
+
+/***************************************************************
+ * undo_move
+ * This reverses the effect of make_move.
+ * 'Us' is the side that made the move.
+ ***************************************************************/
+template <int Us>
+void CBoard::undo_move(const CMove &move, const t_undo &undo)
+{
+    const int8_t sign = (Us == WHITE) ? 1 : -1;
+    const int    up   = (Us == WHITE) ? N : S;
+    const int    flip = (Us == WHITE) ? 0 : 56;
+
+    int from = move.From();
+    int to   = move.To();
+
+    m_side_to_move = sign;
+
+    int8_t piece = m_board[to];
+    if (move.is_it_a_promotion())
+        piece = WP * sign;
+
+    // Put back the piece that moved, and anything it captured.
+    remove_piece(to);
+    put_piece(from, piece);
+    if (undo.captured != EM)
+        put_piece(to, undo.captured);
+
+    switch (piece*sign)
+    {
         case WP :
-            if (move.To() - move.From() == 20) // White double pawn move
-            {
-                m_enPassantSquare = move.From() + 10;
-            }
-            else if (move.To() - move.From() != 10) // White pawn capture
-            {
-                if (m_board[move.To()] == EM) { // En-passant capture
-                    m_board[move.To() - 10] = EM;
-                }
-            }
+            if (move.is_it_en_passant())
+                put_piece(to - up, -WP*sign);
             break;
 
-        case BP :
-            if (move.From() - move.To() == 20) // Black double pawn move
-            {
-                m_enPassantSquare = move.To() + 10;
-            }
-            else if (move.From() - move.To() != 10) // Black pawn capture
+        case WK :
+            if (move.is_it_castling())
             {
-                if (m_board[move.To()] == EM) { // En-passant capture
-                    m_board[move.To() + 10] = EM;
-                }
+                if (to == (G1^flip)) // Castling short
+                    move_piece(F1^flip, H1^flip);
+                else                 // Castling long
+                    move_piece(D1^flip, A1^flip);
             }
+            m_kingSquare[Us] = from;
             break;
 
         default :
             break;
     } // end of switch
 
-    m_board[move.To()] = m_board[move.From()];
-    if (move.GetPromoted() != EM)
-        m_board[move.To()] = move.GetPromoted();
-    m_board[move.From()] = EM;
-    m_side_to_move = -m_side_to_move;
-    m_material = -m_material;
-} // end of void CBoard::make_move(const CMove &move)
+    m_material        = undo.material;
+    m_halfMoves       = undo.halfMoves;
+    m_enPassantSquare = undo.enPassantSquare;
+    m_castleRights    = undo.castleRights;
+    m_hashKey         = undo.hashKey;
+    m_pstMg           = undo.pstMg;
+    m_pstEg           = undo.pstEg;
+    m_phase           = undo.phase;
+} // end of undo_move
 
 
 /***************************************************************
  * undo_move
  * This reverses the effect of make_move
  ***************************************************************/
-void CBoard::undo_move(const CMove &move)
+void CBoard::undo_move(const CMove &move, const t_undo &undo)
 {
-    m_material = -m_material;
-    switch (move.GetCaptured())
-    {
-        case WP : case BP : m_material -= 1; break;
-        case WN : case BN : m_material -= 3; break;
-        case WB : case BB : m_material -= 3; break;
-        case WR : case BR : m_material -= 5; break;
-        case WQ : case BQ : m_material -= 9; break;
-        default : break;
-    }
+    // The move was made by the opponent of the side to move.
+    if (m_side_to_move > 0)
+        undo_move<BLACK>(move, undo);
+    else
+        undo_move<WHITE>(move, undo);
+} // end of void CBoard::undo_move(const CMove &move, const t_undo &undo)
 
-    switch (move.GetPromoted())
-    {
-        case WN : case BN : m_material -= 3-1; break;
-        case WB : case BB : m_material -= 3-1; break;
-        case WR : case BR : m_material -= 5-1; break;
-        case WQ : case BQ : m_material -= 9-1; break;
-        default : break;
-    }
 
-    m_enPassantSquare = 0;
-    switch (m_board[move.To()])
+/***************************************************************
+ * IsMoveValid
+ * This returns true, if the move is legal, and fills in the move
+ * type. No moves are generated (except for castling). Instead,
+ * the moving piece must be able to reach the destination square,
+ * and the king must not be attacked after the move.
+ ***************************************************************/
+template <int Us>
+bool CBoard::IsMoveValid(CMove &move) const
+{
+    const int    Them  = Us ^ 1;
+    const int8_t sign  = (Us == WHITE) ? 1 : -1;
+    const int    up    = (Us == WHITE) ? N : S;
+    const int    flip  = (Us == WHITE) ? 0 : 56;
+    const bitboard_t rank2 = (Us == WHITE) ? RANK_1 << 8 : RANK_8 >> 8;
+
+    int from = move.From();
+    int to   = move.To();
+
+    bitboard_t occ      = occupied();
+    bitboard_t fromBB   = bb_square(from);
+    bitboard_t toBB     = bb_square(to);
+    bitboard_t captured = m_colorBB[Them] & toBB; // The square emptied by a capture
+
+    if (!(m_colorBB[Us] & fromBB) || (m_colorBB[Us] & toBB))
+        return false;
+
+    int type = MOVE_NORMAL;
+    int ksq  = m_kingSquare[Us];
+
+    switch (m_board[from]*sign)
     {
         case WP :
-            if ((move.To() - move.From())%10 != 0 && move.GetCaptured() == EM)
+            if (pawnAttacks[Us][from] & toBB)
             {
-                m_enPassantSquare = move.To();
-                m_board[m_enPassantSquare - 10] = BP;
+                if (m_enPassantSquare && to == m_enPassantSquare)
+                {
+                    type     = MOVE_EN_PASSANT;
+                    captured = bb_square(to - up);
+                }
+                else if (!captured)
+                    return false;
             }
+            else if (captured)
+                return false;
+            else if (to != from + up
+                     && !(to == from + up+up && (fromBB & rank2) && !(occ & bb_square(from + up))))
+                return false;
+
+            // A pawn reaching the last row must promote, and only then.
+            if (((toBB & (RANK_1 | RANK_8)) != 0) != move.is_it_a_promotion())
+                return false;
+            if (move.is_it_a_promotion())
+                type = MOVE_PROMOTION;
             break;
 
-        case BP :
-            if ((move.From() - move.To())%10 != 0 && move.GetCaptured() == EM)
-            {
-                m_enPassantSquare = move.To();
-                m_board[m_enPassantSquare + 10] = WP;
-            }
+        case WN :
+            if (!(knightAttacks[from] & toBB))
+                return false;
             break;
 
-        case WK :
-            if (move.From() == E1 &&
-                    move.To() == G1) // White castling short
-            {
-                m_board[F1] = EM;
-                m_board[H1] = WR;
-            }
-            else if (move.From() == E1 &&
-                    move.To() == C1) // White castling long
-            {
-                m_board[D1] = EM;
-                m_board[A1] = WR;
-            }
+        case WB :
+            if (!(bishopAttacks(from, occ) & toBB))
+                return false;
             break;
 
-        case BK :
-            if (move.From() == E8 &&
-                    move.To() == G8) // Black castling short
-            {
-                m_board[F8] = EM;
-                m_board[H8] = BR;
-            }
-            else if (move.From() == E8 &&
-                    move.To() == C8) // Black castling long
+        case WR :
+            if (!(rookAttacks(from, occ) & toBB))
+                return false;
+            break;
+
+        case WQ :
+            if (!(queenAttacks(from, occ) & toBB))
+                return false;
+            break;
+
+        case WK :
+            // Castling is rare enough to simply generate it.
+            if (from == (E1^flip) && (to == (G1^flip) || to == (C1^flip)) && !move.is_it_a_promotion())
             {
-                m_board[D8] = EM;
-                m_board[A8] = BR;
+                CMoveList moves;
+                find_moves<Us, GEN_QUIETS>(moves, toBB);
+                for (unsigned int i=0; i<moves.size(); ++i)
+                {
+                    if (moves[i].From() == from && moves[i].is_it_castling())
+                    {
+                        move = moves[i];
+                        return true;
+                    }
+                }
+                return false;
             }
+            if (!(kingAttacks[from] & toBB))
+                return false;
+            ksq = to;
             break;
 
         default :
-            break;
-    } // end of switch
+            return false;
+    }
 
-    m_board[move.From()] = move.GetPiece();
-    m_board[move.To()] = move.GetCaptured();
-    m_side_to_move = -m_side_to_move;
+    if (type != MOVE_PROMOTION && move.is_it_a_promotion())
+        return false;
 
-    if (!m_state.empty())
-    {
-        uint32_t state = m_state.back();
-        m_enPassantSquare = state >> 8;
-        m_castleRights = state & 0xFF;
-        m_state.pop_back();
-    }
+    // Is the king attacked after the move?
+    bitboard_t occAfter = (occ & ~fromBB & ~captured) | toBB;
+    if (attackersTo(ksq, occAfter) & occAfter & m_colorBB[Them] & ~captured)
+        return false;
+
+    if (type == MOVE_PROMOTION)
+        move = CMove(from, to, MOVE_PROMOTION, move.GetPromoted());
     else
-    {
-        m_enPassantSquare = 0;
-    }
-} // end of void CBoard::undo_move(const CMove &move)
+        move = CMove(from, to, type);
+    return true;
+} // end of IsMoveValid
 
 
 /***************************************************************
@@ -1382,28 +1409,70 @@ void CBoard::undo_move(const CMove &move)
  ***************************************************************/
 bool CBoard::IsMoveValid(CMove &move) const
 {
-    CMoveList moves;
-    find_legal_moves(moves);
-    for (unsigned int i=0; i<moves.size(); ++i)
-    {
-        if (moves[i] == move)
-        {
-            move.SetPiece(m_board[move.From()]);
-            move.SetCaptured(m_board[move.To()]);
-            return true;
-        }
-    }
-    return false;
+    if (m_side_to_move > 0)
+        return IsMoveValid<WHITE>(move);
+    else
+        return IsMoveValid<BLACK>(move);
 } // end of bool CBoard::IsMoveValid(CMove &move)
 
 
+/***************************************************************
+ * mobility
+ *
+ * Counts the moves of the given side, directly from the attack
+ * sets, without generating the moves. Pins and checks are
+ * ignored, so this is the number of pseudo-legal moves, except
+ * that castling, en-passant, and under-promotions are not counted.
+ * The side to move is irrelevant, and the board is not changed.
+ ***************************************************************/
+template <int Color>
+int CBoard::mobility() const
+{
+    const int        up    = (Color == WHITE) ? N : S;
+    const bitboard_t rank3 = (Color == WHITE) ? RANK_3 : RANK_6;
+
+    bitboard_t occ   = occupied();
+    bitboard_t empty = ~occ;
+    bitboard_t own   = m_colorBB[Color];
+    bitboard_t enemy = m_colorBB[Color ^ 1];
+    bitboard_t pawns = pieces(WP, Color);
+
+    int count = 0;
+
+    // Pawns are counted all at once.
+    bitboard_t single = bb_shift<up>(pawns) & empty;
+    count += bb_count(single);
+    count += bb_count(bb_shift<up>(single & rank3) & empty);
+    count += bb_count(bb_shift<up+W>(pawns & ~FILE_A) & enemy);
+    count += bb_count(bb_shift<up+E>(pawns & ~FILE_H) & enemy);
+
+    bitboard_t bb = pieces(WN, Color);
+    while (bb)
+        count += bb_count(knightAttacks[bb_pop(bb)] & ~own);
+
+    bitboard_t queens = pieces(WQ, Color);
+
+    bb = pieces(WB, Color) | queens;
+    while (bb)
+        count += bb_count(bishopAttacks(bb_pop(bb), occ) & ~own);
+
+    bb = pieces(WR, Color) | queens;
+    while (bb)
+        count += bb_count(rookAttacks(bb_pop(bb), occ) & ~own);
+
+    count += bb_count(kingAttacks[m_kingSquare[Color]] & ~own);
+
+    return count;
+} // end of mobility
+
+
 /***************************************************************
  * get_value
  *
  * It returns an integer value showing how good the position
  * is for the side to move.
  *
- * This is a very simple evaluation function. Only two factors are
+ * This is a very simple evaluation function. Only three factors are
  * considered:
  * 1. The material balance:
  *      * Pawn   100
@@ -1411,23 +1480,24 @@ bool CBoard::IsMoveValid(CMove &move) const
  *      * Bishop 300
  *      * Rook   500
  *      * Queen  900
- * 2. The difference in number of legal moves of both players.
+ * 2. The difference in mobility (number of moves) of both players.
  *
- * The latter tends to favor positions, where the computer
- * has many legal moves. This implies centralization and development.
+ * 3. The piece-square tables, see pst.h.
+ *
+ * The mobility tends to favor positions, where the computer
+ * has many moves. This implies centralization and development.
  ***************************************************************/
-int CBoard::get_value()
+int CBoard::get_value() const
 {
-    CMoveList moves;
-    find_legal_moves(moves);
-    int my_moves = moves.size();
-    swap_sides();
+    int my_moves  = whiteToMove() ? mobility<WHITE>() : mobility<BLACK>();
+    int his_moves = whiteToMove() ? mobility<BLACK>() : mobility<WHITE>();
 
-    find_legal_moves(moves);
-    int his_moves = moves.size();
-    swap_sides();
+    // Blend the middlegame and endgame scores by the game phase.
+    // Promotions may give more than the initial material.
+    int phase = (m_phase < PHASE_MAX) ? m_phase : PHASE_MAX;
+    int pst   = (m_pstMg*phase + m_pstEg*(PHASE_MAX-phase)) / PHASE_MAX;
 
-    return (my_moves-his_moves) + 100*m_material;
+    return (my_moves-his_moves) + 100*m_material + pst*m_side_to_move;
 } // end of int CBoard::get_value()
 
 
@@ -1436,25 +1506,9 @@ int CBoard::get_value()
  ***************************************************************/
 bool CBoard::isKingInCheck() const
 {
-    e_piece king;
-    CSquare kingSquare = 0;
+    int kingSquare = m_kingSquare[(m_side_to_move > 0) ? WHITE : BLACK];
 
-    if (m_side_to_move == 1)
-        king = WK;
-    else
-        king = BK;
-
-    // Look for our king
-    for (int i=A1; i<=H8; ++i)
-    {
-        if (m_board[i] == king)
-        {
-            kingSquare = i;
-            break;
-        }
-    }
-
-    assert (kingSquare != 0); // The king MUST be somewhere
+    assert (m_board[kingSquare] == WK*m_side_to_move); // The king MUST be there
 
     return isSquareThreatened(kingSquare);
 
@@ -1473,6 +1527,19 @@ bool CBoard::isOtherKingInCheck() const
 } // end of isOtherKingInCheck
 
 
+/***************************************************************
+ * Returns true if neither player can possibly checkmate, i.e.
+ * only the kings and at most one knight or bishop are left.
+ ***************************************************************/
+bool CBoard::isInsufficientMaterial() const
+{
+    if (m_typeBB[WP-1] | m_typeBB[WR-1] | m_typeBB[WQ-1])
+        return false;
+
+    return bb_count(m_typeBB[WN-1] | m_typeBB[WB-1]) <= 1;
+} // end of isInsufficientMaterial
+
+
 #ifdef DEBUG_HASH
 /***************************************************************
  * calcHash
@@ -1481,7 +1548,7 @@ uint32_t CBoard::calcHash() const
 {
     CRC32 crc;
 
-    for (int i=0; i<120; ++i)
+    for (int i=0; i<64; ++i)
     {
         crc.update(m_board[i]);
     }
@@ -1494,31 +1561,3 @@ uint32_t CBoard::calcHash() const
 } // end of calcHash
 #endif
 
-
-/***************************************************************
- * copy constructor
- ***************************************************************/
-CBoard::CBoard(const CBoard& rhs)
-    : m_board(), m_state(), m_side_to_move(), m_castleRights(),
-    m_enPassantSquare(), m_material(), m_halfMoves(), m_fullMoves()
-{
-    m_side_to_move    = rhs.m_side_to_move;
-    m_castleRights    = rhs.m_castleRights;
-    m_enPassantSquare = rhs.m_enPassantSquare;
-    m_material        = rhs.m_material;
-
-    m_board.clear();
-    m_board.reserve(120);
-    for (int i=0; i<120; ++i)
-    {
-        m_board[i] = rhs.m_board[i];
-    }
-
-    m_state.clear();
-    for (std::vector<uint32_t>::const_iterator it = rhs.m_state.begin();
-            it != rhs.m_state.end(); ++it)
-    {
-        m_state.push_back(*it);
-    }
-} // end of copy constructor
-
@@ -1,29 +1,28 @@
-#include <vector>
 #include <string>
 
 #include "CMove.h"
 #include "CMoveList.h"
+#include "bitboard.h"
+#include "zobrist.h"
+#include "pst.h"
 
 #ifndef _C_BOARD_H_
 #define _C_BOARD_H_
 
-// The board is represented as an array of 120 elements.
-// arranged in 12 rows and 10 columns.
+// The board is represented as a set of bitboards, one for each piece type
+// and one for each colour, see bitboard.h.
+// Additionally, an array of 64 elements contains the piece on each square.
 // The following diagram shows the numbering of the elements.
-// Note: The square A1 is element number 21
+// Note: The square A1 is element number 0
 //
-// 111 118 112 113 114 115 116 117 118 119
-// 100 108 102 103 104 105 106 107 108 109
-//  90  A8  92  93  94  95  96  97  H8  99
-//  80  88  82  83  84  85  86  87  88  89
-//  70  71  72  73  74  75  76  77  78  79
-//  60  61  62  63  64  65  66  67  68  69
-//  50  51  52  53  54  55  56  57  58  59
-//  40  41  42  43  44  45  46  47  48  49
-//  30  31  32  33  34  35  36  37  H2  39
-//  20  A1  22  23  24  25  26  27  H1  29
-//  10  11  12  13  14  15  16  17  18  19
-//   0   1   2   3   4   5   6   7   8   9
+//  A8  57  58  59  60  61  62  H8
+//  48  49  50  51  52  53  54  55
+//  40  41  42  43  44  45  46  47
+//  32  33  34  35  36  37  38  39
+//  24  25  26  27  28  29  30  31
+//  16  17  18  19  20  21  22  23
+//   8   9  10  11  12  13  14  H2
+//  A1   1   2   3   4   5   6  H1
 //
 // Each element contains one of the following values:
 //   0  :  Empty
@@ -39,64 +38,191 @@
 //   -4 :  Black Rook
 //   -5 :  Black Queen
 //   -6 :  Black King
-//   99 :  INVALID
 
 enum // Directions
 {
-    N = 10, S = -10, E = -1, W = 1,
-    NW = 11, SW = -9, NE = 9, SE = -11,
-    NNW = 21, NNE = 19, NWW = 12, NEE = 8,
-    SSW = -19, SSE = -21, SWW = -8, SEE = -12
+    N = 8, S = -8, E = 1, W = -1,
+    NW = 7, SW = -9, NE = 9, SE = -7
 };
 
+enum // Move generation types
+{
+    GEN_CAPTURES = 1,
+    GEN_QUIETS   = 2,
+    GEN_ALL      = GEN_CAPTURES | GEN_QUIETS
+};
+
+// Maximum search depth, counted from the root, including quiescence.
+#define MAX_PLY 64
+
+// Everything that make_move can not reverse by itself.
+// This is filled in by make_move, and undo_move simply copies it
+// back. The search keeps one entry per ply, indexed by ply.
+typedef struct
+{
+    uint64_t hashKey;
+    int16_t  pstMg;
+    int16_t  pstEg;
+    int16_t  material;
+    int16_t  halfMoves;
+    int8_t   captured;
+    uint8_t  castleRights;
+    uint8_t  enPassantSquare;
+    uint8_t  phase;
+} t_undo;
+
 /***************************************************************
  * declaration of CBoard
+ *
+ * The board is trivially copyable, i.e. a copy is a plain memcpy.
+ * This allows the search to copy the board instead of undoing
+ * the move (see COPY_MAKE in the Makefile).
  ***************************************************************/
 class CBoard
 {
     public:
-        CBoard() : m_board(), m_state(), m_side_to_move(), m_castleRights(),
-            m_enPassantSquare(), m_material(), m_halfMoves(), m_fullMoves()
+        CBoard() : m_typeBB(), m_colorBB(), m_hashKey(), m_pstMg(), m_pstEg(), m_phase(), m_board(), m_kingSquare(), m_side_to_move(),
+            m_castleRights(), m_enPassantSquare(), m_material(), m_halfMoves(), m_fullMoves()
             { newGame(); }
 
-        // Copy constructor
-        CBoard(const CBoard& rhs);
-
         void newGame();
         bool read_from_fen(const char *fen, const char **endptr = NULL);
         CMove readMove(const char *fen, const char **endptr) const;
-        void find_legal_moves(CMoveList &moves) const;
-        void make_move(const CMove &move);
-        void undo_move(const CMove &move);
-        int  get_value();
+        void find_legal_moves(CMoveList &moves) const {find_moves(moves, GEN_ALL);}
+        void find_captures(CMoveList &moves) const    {find_moves(moves, GEN_CAPTURES);} // Including promotions
+        void find_quiets(CMoveList &moves) const      {find_moves(moves, GEN_QUIETS);}
+        void make_move(const CMove &move, t_undo &undo);
+        void make_move(const CMove &move) {t_undo undo; make_move(move, undo);} // Can not be undone
+        void undo_move(const CMove &move, const t_undo &undo);
+        int  get_value() const;
         bool IsMoveValid(CMove &move) const;
+        int  see(const CMove &move) const;
 #ifdef DEBUG_HASH
         uint32_t calcHash() const;
 #endif
         bool isKingInCheck() const;
         bool isOtherKingInCheck() const;
+        bool isInsufficientMaterial() const;
+        int  halfMoves() const {return m_halfMoves;} // Since the last capture or pawn move
         bool whiteToMove() const {return m_side_to_move > 0;}
+        uint64_t hashKey() const {return m_hashKey;}
+        uint64_t calcHashKey() const;
+        uint64_t hashKeyAfter(const CMove& move) const {return m_hashKey ^ hashKeyDelta(move);} // Without making it
+
+        // These are only valid BEFORE the move is made.
+        int8_t movedPiece(const CMove& move) const {return m_board[move.From()];}
+        int8_t capturedPiece(const CMove& move) const // En-passant returns EM
+            {return m_board[move.To()];}
+        bool   isCapture(const CMove& move) const
+            {return m_board[move.To()] != EM || move.is_it_en_passant();}
 
         friend std::ostream& operator <<(std::ostream &os, const CBoard &rhs);
-        friend class CHashEntry;
 
     private:
         void calcMaterial();
+        void calcPst();
+        void calcBitboards();
+        bool parse_fen(const char *fen, const char **endptr);
+        uint64_t hashKeyDelta(const CMove& move) const;
         bool isSquareThreatened(const CSquare& sq) const;
-        void swap_sides() {m_side_to_move = -m_side_to_move;}
+        bitboard_t attackersTo(int sq, bitboard_t occ) const;
+        void find_moves(CMoveList &moves, int genType, bitboard_t targets = ~0ULL) const;
+
+        // These are specialized for the colour to move (WHITE or BLACK),
+        // so the innermost loops do not test the side to move.
+        // The non-template functions select the version to call.
+        template <int Us> bool isSquareThreatened(int sq) const;
+        template <int Color> bitboard_t attackedBy(bitboard_t occ) const;
+        template <int Us> void find_pawn_moves(CMoveList &moves, bitboard_t pawns, bitboard_t mask) const;
+        template <int Us, int GenType> void find_moves(CMoveList &moves, bitboard_t targets) const;
+        template <int Us> bool IsMoveValid(CMove &move) const;
+        template <int Us> void make_move(const CMove &move, t_undo &undo);
+        template <int Us> void undo_move(const CMove &move, const t_undo &undo);
+        template <int Color> int mobility() const;
+
+        // Bitboard of all pieces of the given type (WP - WK) and colour.
+        bitboard_t pieces(int type, int color) const
+            {return m_typeBB[type-1] & m_colorBB[color];}
+        bitboard_t occupied() const {return m_colorBB[WHITE] | m_colorBB[BLACK];}
 
-        std::vector<int8_t>   m_board;
-        std::vector<uint32_t> m_state; // Contains a log of m_enPassantSquare and m_castleRights
-        int m_side_to_move;
-        int m_castleRights;
+        // These keep the bitboards and m_board consistent.
+        void put_piece(int sq, int8_t piece)
+        {
+            bitboard_t bb = bb_square(sq);
+            m_typeBB[(piece > 0 ? piece : -piece) - 1] |= bb;
+            m_colorBB[piece > 0 ? WHITE : BLACK]       |= bb;
+            m_board[sq] = piece;
+        }
+        void remove_piece(int sq)
+        {
+            int8_t piece = m_board[sq];
+            bitboard_t bb = bb_square(sq);
+            m_typeBB[(piece > 0 ? piece : -piece) - 1] &= ~bb;
+            m_colorBB[piece > 0 ? WHITE : BLACK]       &= ~bb;
+            m_board[sq] = EM;
+        }
+        void move_piece(int from, int to)
+        {
+            int8_t piece = m_board[from];
+            bitboard_t bb = bb_square(from) | bb_square(to);
+            m_typeBB[(piece > 0 ? piece : -piece) - 1] ^= bb;
+            m_colorBB[piece > 0 ? WHITE : BLACK]       ^= bb;
+            m_board[to]   = piece;
+            m_board[from] = EM;
+        }
+
+        // These update the piece-square score and the game phase,
+        // when a piece is added to or removed from a square. This is
+        // separate from the above, because undo_move restores these
+        // values from t_undo instead. The hash key is updated by
+        // make_move, see hashKeyDelta.
+        void incr_add(int8_t piece, int sq)
+        {
+            m_pstMg   += pst_mg(piece, sq);
+            m_pstEg   += pst_eg(piece, sq);
+            m_phase   += pst_phase(piece);
+        }
+        void incr_remove(int8_t piece, int sq)
+        {
+            m_pstMg   -= pst_mg(piece, sq);
+            m_pstEg   -= pst_eg(piece, sq);
+            m_phase   -= pst_phase(piece);
+        }
+
+        bitboard_t  m_typeBB[6];     // Indexed by piece type minus one
+        bitboard_t  m_colorBB[2];    // Indexed by WHITE or BLACK
+        uint64_t    m_hashKey;       // Zobrist key, see zobrist.h
+        int16_t     m_pstMg;         // Piece-square score for White, see pst.h
+        int16_t     m_pstEg;
+        uint8_t     m_phase;
+        int8_t      m_board[64];
+        uint8_t     m_kingSquare[2]; // Indexed by WHITE or BLACK
+        int8_t      m_side_to_move;
+        uint8_t     m_castleRights;
 #define CASTLE_WHITE_SHORT (1<<0)
 #define CASTLE_WHITE_LONG  (1<<1)
 #define CASTLE_BLACK_SHORT (1<<2)
 #define CASTLE_BLACK_LONG  (1<<3)
-        int m_enPassantSquare;
-        int m_material;
-        int m_halfMoves;
-        int m_fullMoves;
+        uint8_t     m_enPassantSquare;
+        int         m_material;
+        int         m_halfMoves;
+        int         m_fullMoves;
+
+        // The castling rights that are lost, when a piece moves
+        // from or to the square.
+        static int castleMask(int sq)
+        {
+            switch (sq)
+            {
+                case A1 : return CASTLE_WHITE_LONG;
+                case H1 : return CASTLE_WHITE_SHORT;
+                case E1 : return CASTLE_WHITE_SHORT | CASTLE_WHITE_LONG;
+                case A8 : return CASTLE_BLACK_LONG;
+                case H8 : return CASTLE_BLACK_SHORT;
+                case E8 : return CASTLE_BLACK_SHORT | CASTLE_BLACK_LONG;
+                default : return 0;
+            }
+        }
 
 }; // end of class CBoard
 
@@ -29,15 +29,13 @@ class CHashEntry
 
         CHashEntry() : m_hashValue(), m_bestMove(), m_nodeTypeAndLevel(), m_searchValue()
             {}
-        void set(const CBoard& board);
-        void update(const CBoard& board, const CMove& move);
         std::string ToString() const;
 
         operator uint64_t() const {return m_hashValue; }
 
     private:
         uint64_t           m_hashValue;        // 8 bytes
-        CMove              m_bestMove;         // 5 bytes
+        CMove              m_bestMove;         // 2 bytes
         t_nodeTypeAndLevel m_nodeTypeAndLevel; // 1 byte
         int16_t            m_searchValue;      // 2 bytes
 
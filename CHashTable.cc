@@ -1,24 +1,251 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
 #include "CHashTable.h"
 
-#define TABLE_SIZE (8*1024*1024)
+static_assert(sizeof(t_hashCluster) == 64, "A cluster must fill one cache line");
+
+// Relaxed atomic access is enough, since the key check detects
+// a mix of two entries. On x86 these are plain loads and stores.
+static inline uint32_t load(const uint32_t& word)
+{
+    return __atomic_load_n(&word, __ATOMIC_RELAXED);
+}
+
+static inline void store(uint32_t& word, uint32_t value)
+{
+    __atomic_store_n(&word, value, __ATOMIC_RELAXED);
+}
+
+// The two data words of a slot:
+//   data[0] : bits  0-15 : Best move
+//             bits 16-31 : Search value
+//   data[1] : bits  0- 7 : Level
+//             bits  8- 9 : Node type
+//             bits 16-23 : Generation
+static inline int slotLevel(uint32_t data1)      {return data1 & 0xFF;}
+static inline int slotNodeType(uint32_t data1)   {return (data1 >> 8) & 3;}
+static inline int slotGeneration(uint32_t data1) {return (data1 >> 16) & 0xFF;}
 
 /***************************************************************
  * constructor
  ***************************************************************/
-CHashTable::CHashTable()
-    : m_table()
+CHashTable::CHashTable(size_t megaBytes)
+    : m_memory(), m_pages(PAGES_NORMAL), m_table(), m_mask(), m_generation(1)
+{
+    resize(megaBytes);
+}
+
+
+/***************************************************************
+ * destructor
+ ***************************************************************/
+CHashTable::~CHashTable()
 {
-    m_table.reserve(TABLE_SIZE);
+    free();
 }
 
 
+/***************************************************************
+ * allocate
+ * Allocates the table of the given size, preferably on huge pages:
+ * On normal 4 KB pages, a large table needs many more TLB entries
+ * than the CPU has, so nearly every probe also misses in the TLB.
+ * Explicitly reserved huge pages (MAP_HUGETLB) are tried first,
+ * then transparent huge pages, and finally plain malloc.
+ * Returns false, if there is not enough memory.
+ ***************************************************************/
+bool CHashTable::allocate(size_t size)
+{
+#ifdef __linux__
+    const size_t hugePageSize = 2*1024*1024;
+
+    if (size % hugePageSize == 0)
+    {
+        void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED)
+        {
+            m_memory = memory;
+            m_pages  = PAGES_HUGETLB;
+            m_table  = (t_hashCluster *) memory;
+            return true;
+        }
+    }
+
+#ifdef MADV_HUGEPAGE
+    // The kernel can only use huge pages for the aligned part of the memory.
+    if (size >= hugePageSize)
+    {
+        void *memory = NULL;
+        if (posix_memalign(&memory, hugePageSize, size))
+            return false;
+
+        m_memory = memory;
+        m_pages  = madvise(memory, size, MADV_HUGEPAGE) ? PAGES_NORMAL : PAGES_TRANSPARENT;
+        m_table  = (t_hashCluster *) memory;
+        return true;
+    }
+#endif
+#endif
+
+    m_memory = malloc(size + 63);
+    if (m_memory == NULL)
+        return false;
+
+    m_pages = PAGES_NORMAL;
+    m_table = (t_hashCluster *) (((uintptr_t) m_memory + 63) & ~(uintptr_t) 63);
+    return true;
+} // end of allocate
+
+
+/***************************************************************
+ * free
+ ***************************************************************/
+void CHashTable::free()
+{
+#ifdef __linux__
+    if (m_memory && m_pages == PAGES_HUGETLB)
+        munmap(m_memory, (m_mask + 1)*sizeof(t_hashCluster));
+    else
+#endif
+        ::free(m_memory);
+    m_memory = NULL;
+    m_table  = NULL;
+} // end of free
+
+
+/***************************************************************
+ * resize
+ * Allocates a new, empty table of at most the given size.
+ * If the memory is not available, the size is halved until it is.
+ * Returns the size actually allocated, in megabytes.
+ ***************************************************************/
+size_t CHashTable::resize(size_t megaBytes)
+{
+    if (megaBytes < HASH_SIZE_MIN)
+        megaBytes = HASH_SIZE_MIN;
+    if (megaBytes > HASH_SIZE_MAX)
+        megaBytes = HASH_SIZE_MAX;
+
+    // Round down to a power of two. On a 32-bit system, the
+    // size is also limited by the address space.
+    uint64_t maxClusters = ((uint64_t) megaBytes << 20) / sizeof(t_hashCluster);
+    size_t   clusters    = 1;
+    while (clusters*2 <= maxClusters && clusters < SIZE_MAX/4/sizeof(t_hashCluster))
+        clusters *= 2;
+
+    // Release the old table first, so both are not needed at once.
+    free();
+
+    while (!allocate(clusters*sizeof(t_hashCluster)))
+    {
+        if (clusters*sizeof(t_hashCluster) <= 1024*1024)
+            throw std::bad_alloc();
+        clusters /= 2;
+    }
+
+    m_mask = clusters - 1;
+    clear();
+    return clusters*sizeof(t_hashCluster) / (1024*1024);
+} // end of resize
+
+
+/***************************************************************
+ * pages
+ ***************************************************************/
+const char *CHashTable::pages() const
+{
+    switch (m_pages)
+    {
+        case PAGES_HUGETLB     : return "huge pages";
+        case PAGES_TRANSPARENT : return "transparent huge pages";
+        default                : return "normal pages";
+    }
+} // end of pages
+
+
+/***************************************************************
+ * clear
+ ***************************************************************/
+void CHashTable::clear()
+{
+    memset((void *) m_table, 0, (m_mask + 1)*sizeof(t_hashCluster));
+} // end of clear
+
+
 /***************************************************************
  * insert
+ * An existing entry for the same position is overwritten, unless
+ * it is deeper and from the current search, and the new entry is
+ * only a bound. Otherwise the least valuable slot in the cluster
+ * is replaced.
+ * The value of an entry is mainly its search depth, and exact
+ * values are preferred to bounds. Entries from previous searches
+ * lose value with every search. Empty slots have level zero and
+ * generation zero, so they are replaced first too.
  ***************************************************************/
 void CHashTable::insert(const CHashEntry& hashEntry)
 {
-    uint32_t ix = hashEntry.m_hashValue & (TABLE_SIZE - 1);
-    m_table[ix] = hashEntry; // Overwrite any existing value
+    t_hashCluster& cluster = m_table[hashEntry.m_hashValue & m_mask];
+    uint32_t       key     = hashEntry.m_hashValue >> 32;
+
+    t_hashSlot *replace = &cluster.slot[0];
+    int         worst   = 1000000;
+
+    uint32_t    oldData0 = 0;
+    uint32_t    oldData1 = 0;
+    bool        found    = false;
+
+    for (int i=0; i<CLUSTER_SIZE; ++i)
+    {
+        t_hashSlot& slot  = cluster.slot[i];
+        uint32_t    data0 = load(slot.data[0]);
+        uint32_t    data1 = load(slot.data[1]);
+        if ((load(slot.check) ^ data0 ^ data1) == key)
+        {
+            replace  = &slot;
+            oldData0 = data0;
+            oldData1 = data1;
+            found    = true;
+            break;
+        }
+
+        int age   = (uint8_t) (m_generation - slotGeneration(data1));
+        int worth = 2*slotLevel(data1) + (slotNodeType(data1) == nodeExact) - 8*age;
+        if (worth < worst)
+        {
+            worst   = worth;
+            replace = &slot;
+        }
+    }
+
+    // A deeper entry from this search is worth more than a shallower
+    // bound, e.g. from the depth zero search of the same position.
+    if (found && slotGeneration(oldData1) == m_generation
+            && slotLevel(oldData1) > hashEntry.m_nodeTypeAndLevel.level
+            && hashEntry.m_nodeTypeAndLevel.nodeType != nodeExact)
+        return;
+
+    // Keep the old move, if the new entry has none.
+    uint16_t move = hashEntry.m_bestMove.GetData();
+    if (!move && found)
+        move = oldData0 & 0xFFFF;
+
+    uint32_t data0 = move | ((uint32_t) (uint16_t) hashEntry.m_searchValue << 16);
+    uint32_t data1 = hashEntry.m_nodeTypeAndLevel.level
+                   | (hashEntry.m_nodeTypeAndLevel.nodeType << 8)
+                   | (m_generation << 16);
+
+    store(replace->data[0], data0);
+    store(replace->data[1], data1);
+    store(replace->check, key ^ data0 ^ data1);
 } // end of insert
 
 
@@ -27,12 +254,47 @@ void CHashTable::insert(const CHashEntry& hashEntry)
  ***************************************************************/
 bool CHashTable::find(uint64_t hashValue, CHashEntry& hashEntry) const
 {
-    uint32_t ix = hashValue & (TABLE_SIZE - 1);
-    if (m_table[ix].m_hashValue == hashValue)
+    const t_hashCluster& cluster = m_table[hashValue & m_mask];
+    uint32_t             key     = hashValue >> 32;
+
+    for (int i=0; i<CLUSTER_SIZE; ++i)
     {
-        hashEntry = m_table[ix];
-        return true;
+        const t_hashSlot& slot = cluster.slot[i];
+
+        // The data is copied first, and only used if it matches the key.
+        uint32_t data0 = load(slot.data[0]);
+        uint32_t data1 = load(slot.data[1]);
+        if ((load(slot.check) ^ data0 ^ data1) == key)
+        {
+            hashEntry.m_hashValue                 = hashValue;
+            hashEntry.m_bestMove.SetData(data0 & 0xFFFF);
+            hashEntry.m_searchValue               = (int16_t) (data0 >> 16);
+            hashEntry.m_nodeTypeAndLevel.level    = slotLevel(data1);
+            hashEntry.m_nodeTypeAndLevel.nodeType = slotNodeType(data1);
+            return true;
+        }
     }
     return false;
 } // end of find
 
+
+/***************************************************************
+ * hashFull
+ * Returns the approximate number of entries per thousand, that
+ * were stored by the current search, as used in the UCI protocol.
+ * Only the first thousand entries are counted.
+ ***************************************************************/
+int CHashTable::hashFull() const
+{
+    int count = 0;
+    for (size_t i=0; i<1000/CLUSTER_SIZE && i<=m_mask; ++i)
+    {
+        for (int j=0; j<CLUSTER_SIZE; ++j)
+        {
+            if (slotGeneration(load(m_table[i].slot[j].data[1])) == m_generation)
+                count++;
+        }
+    }
+    return count;
+} // end of hashFull
+
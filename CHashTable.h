@@ -1,26 +1,89 @@
 #ifndef _CHASHTABLE_H_
 #define _CHASHTABLE_H_
 
-#include <vector>
+#include <stddef.h>
 
 #include "CBoard.h"
 #include "CHashEntry.h"
 
+// Default size of the transposition table, in megabytes.
+#define HASH_SIZE_DEFAULT 128
+#define HASH_SIZE_MIN     1
+#define HASH_SIZE_MAX     65536
+
+// The compact form of a CHashEntry, as stored in the table.
+// Only the upper half of the hash value is stored, because the
+// lower bits are given by the position in the table.
+// The data is packed into two words (see CHashTable.cc), and the
+// key is stored XOR'ed with both. An entry, that was read while
+// another thread was writing it, then fails the key check.
+typedef struct
+{
+    uint32_t check;   // Upper 32 bits of the hash value ^ data[0] ^ data[1]
+    uint32_t data[2]; // Move, value, level, node type, and generation
+} t_hashSlot;
+
+// The slots of one cluster share a cache line, and are probed together.
+#define CLUSTER_SIZE 5
+
+typedef struct alignas(64)
+{
+    t_hashSlot slot[CLUSTER_SIZE];
+} t_hashCluster;
+
 /***************************************************************
  * declaration of CHashTable
  *
- * This is a wrapper for the std::vector class.
- * It contains an array of hash values.
+ * It contains an array of clusters of hash entries.
+ * The memory is allocated directly, aligned to the cache lines,
+ * and on huge pages when possible, see allocate().
+ * Each entry is stamped with the generation, i.e. the number of
+ * the search, modulo 256. The table therefore never needs to be
+ * cleared, because the entries of old searches are soon replaced.
+ *
+ * The table may be shared by several threads without locking:
+ * Each word of an entry is read and written atomically, and a
+ * torn entry is detected by the key check, see t_hashSlot.
+ * The number of clusters is a power of two, so the index is
+ * simply the lower bits of the hash value.
  ***************************************************************/
 class CHashTable
 {
     public:
-        CHashTable();
+        CHashTable(size_t megaBytes = HASH_SIZE_DEFAULT);
+        ~CHashTable();
+        size_t resize(size_t megaBytes);
+        void clear();
         void insert(const CHashEntry& hashEntry);
         bool find(uint64_t hashValue, CHashEntry& hashEntry) const;
+
+        // Called at the start of each search. Entries from older
+        // searches are then replaced first. Zero marks empty slots.
+        void newSearch() {if (++m_generation == 0) m_generation = 1;}
+        int  hashFull() const;
+        const char *pages() const; // The kind of memory pages used
+
+        // Loads the cluster of this hash value into the cache, so
+        // that it is there by the time it is needed.
+        void prefetch(uint64_t hashValue) const
+        {
+            __builtin_prefetch(&m_table[hashValue & m_mask]);
+        }
         
     private:
-        std::vector<CHashEntry> m_table;
+        CHashTable(const CHashTable&);            // Not copyable
+        CHashTable& operator=(const CHashTable&);
+
+        bool allocate(size_t size);
+        void free();
+
+        enum {PAGES_NORMAL, PAGES_TRANSPARENT, PAGES_HUGETLB};
+
+        void          *m_memory; // As returned by malloc or mmap
+        int            m_pages;  // How m_memory was allocated
+        t_hashCluster *m_table;  // Aligned to a cache line
+        size_t         m_mask;   // Number of clusters minus one
+        uint8_t        m_generation;
 }; // end of CHashTable
 
 #endif // _CHASHTABLE_H_
@@ -22,58 +22,78 @@ typedef enum {
 
 /***************************************************************
  * declaration of CMove
+ *
+ * A move is packed into 16 bits:
+ * Bits  0- 5 : From square
+ * Bits  6-11 : To square
+ * Bits 12-13 : Promoted piece (0=Knight, 1=Bishop, 2=Rook, 3=Queen)
+ * Bits 14-15 : Move type (see below)
+ *
+ * The moving and the captured piece are not stored. They are
+ * found on the board, before the move is made.
+ * The value zero is never a legal move (A1 to A1), so this is
+ * used for the invalid move.
  ***************************************************************/
 
+enum // Move types
+{
+    MOVE_NORMAL     = 0,
+    MOVE_PROMOTION  = 1,
+    MOVE_EN_PASSANT = 2,
+    MOVE_CASTLING   = 3
+};
+
 class CMove
 {
     public:
 
         // Constructors
-        CMove() : m_from(), m_to(), m_piece(IV), m_captured(IV), m_promoted() {}
+        CMove() : m_data(0) {}
 
-        CMove(const char *str) : m_from(), m_to(), m_piece(IV), m_captured(IV), m_promoted()
+        CMove(const char *str) : m_data(0)
             { FromString(str); }
 
-        CMove(int8_t piece, const CSquare& from, const CSquare& to, int8_t captured = EM, int8_t promoted=EM) :
-            m_from(from), m_to(to), m_piece(piece), m_captured(captured), m_promoted(promoted) {}
+        // 'promoted' is the piece type (WN - WQ), regardless of colour.
+        CMove(const CSquare& from, const CSquare& to, int type = MOVE_NORMAL, int8_t promoted = WN) :
+            m_data(from | (to << 6) | ((promoted - WN) << 12) | (type << 14)) {}
 
 
         // Modifiers
         const char * FromString(const char *s); // Returns NULL if error
 
-        void SetCaptured(int8_t captured) { m_captured = captured; }
-        void SetPiece(int8_t piece) { m_piece = piece; }
-
 
         // Accessor functions
         std::string ToShortString() const;
-        std::string ToLongString() const;
 
-        CSquare     From(void) const {return m_from;}
-        CSquare     To(void) const {return m_to;}
-        int8_t      GetPiece(void) const { return m_piece; }
-        int8_t      GetCaptured(void) const { return m_captured; }
-        int8_t      GetPromoted(void) const { return m_promoted; }
+        CSquare     From(void) const {return m_data & 63;}
+        CSquare     To(void) const {return (m_data >> 6) & 63;}
+        int         GetType(void) const {return m_data >> 14;}
+
+        // The raw 16 bits, e.g. for packing the move into the hash table.
+        uint16_t    GetData(void) const {return m_data;}
+        void        SetData(uint16_t data) {m_data = data;}
+
+        // Returns the promoted piece type (WN - WQ), or EM.
+        int8_t      GetPromoted(void) const
+            { return is_it_a_promotion() ? ((m_data >> 12) & 3) + WN : EM; }
 
         // Utility functions
-        bool        Valid(void) const { return GetCaptured() != IV; }
-        bool        is_captured_piece_a_king(void) const { return (GetCaptured() == WK || GetCaptured() == BK); }
-        bool        is_it_a_capture(void) const { return (GetCaptured() != EM); }
-        bool        operator==(const CMove& rhs) const
+        bool        Valid(void) const { return m_data != 0; }
+        bool        is_it_a_promotion(void) const { return GetType() == MOVE_PROMOTION; }
+        bool        is_it_en_passant(void) const { return GetType() == MOVE_EN_PASSANT; }
+        bool        is_it_castling(void) const { return GetType() == MOVE_CASTLING; }
+        bool        operator==(const CMove& rhs) const { return m_data == rhs.m_data; }
+
+        // A move read from a string has no type (except promotion), since
+        // this depends on the position. This compares only the squares
+        // and the promoted piece.
+        bool        is_same_as(const CMove& rhs) const
         {
-            if (rhs.From() != From())
-                return false;
-            if (rhs.To() != To())
-                return false;
-            return true;
+            return From() == rhs.From() && To() == rhs.To() && GetPromoted() == rhs.GetPromoted();
         }
 
     private:
-        CSquare     m_from;
-        CSquare     m_to;
-        int8_t      m_piece;
-        int8_t      m_captured;
-        int8_t      m_promoted;
+        uint16_t    m_data;
 }; /* end of CMove */
 
 std::ostream& operator <<(std::ostream &os, const CMove &rhs);
@@ -9,23 +9,10 @@ std::ostream& operator <<(std::ostream &os, const CMoveList &rhs)
 std::string CMoveList::ToShortString() const
 {
     std::stringstream ss;
-    for (std::vector<CMove>::const_iterator it = m_moveList.begin(); it != m_moveList.end(); ++it)
+    for (unsigned int i=0; i<m_size; ++i)
     {
-        ss << (*it).ToShortString() << " ";
+        ss << m_moves[i].ToShortString() << " ";
     }
 
     return ss.str();
 }
-
-std::string CMoveList::ToLongString() const
-{
-    std::stringstream ss;
-    for (std::vector<CMove>::const_iterator it = m_moveList.begin(); it != m_moveList.end(); ++it)
-    {
-        ss << (*it).ToLongString() << " ";
-    }
-
-    return ss.str();
-
-}
-
@@ -2,39 +2,48 @@
 #define _C_MOVELIST_H_
 
 #include <iostream>
-#include <vector>
+#include <assert.h>
 
 #include "CMove.h"
 
 /***************************************************************
  * declaration of CMoveList
  *
- * This is a wrapper for the std::vector class.
- * It contains an array of moves.
+ * This contains an array of moves.
+ * The array has a fixed capacity and lives on the stack,
+ * so that no memory is allocated during the search.
+ * No legal chess position has more than 218 moves.
  ***************************************************************/
 
+#define MAX_MOVES 256
+
 class CMoveList
 {
     public:
-        CMoveList()
-            : m_moveList()
+        CMoveList() : m_moves(), m_size(0)
+        { }
+
+        // Only the moves in use are copied.
+        CMoveList(const CMoveList& rhs) : m_moves(), m_size(0)
+        {
+            *this += rhs;
+        }
+
+        CMoveList& operator = (const CMoveList& rhs)
         {
-            // Pre-allocate space for a large number of moves.
-            // This is a slight optimization.
-            m_moveList.reserve(100);
+            m_size = 0;
+            return *this += rhs;
         }
 
         friend std::ostream& operator <<(std::ostream &os, const CMoveList &rhs);
 
         std::string ToShortString() const;
 
-        std::string ToLongString() const;
-
         bool is_in(const CMove& move) const
         {
-            for (std::vector<CMove>::const_iterator it = m_moveList.begin(); it != m_moveList.end(); ++it)
+            for (unsigned int i=0; i<m_size; ++i)
             {
-                if ((*it) == move)
+                if (m_moves[i] == move)
                     return true;
             }
             return false;
@@ -42,33 +51,43 @@ class CMoveList
 
         void push_back(const CMove& move)
         {
-            m_moveList.push_back(move);
+            assert(m_size < MAX_MOVES);
+            m_moves[m_size++] = move;
         }
 
         void insert_front(const CMove& move)
         {
-            m_moveList.insert(m_moveList.begin(), move);
+            assert(m_size < MAX_MOVES);
+            for (unsigned int i=m_size; i>0; --i)
+            {
+                m_moves[i] = m_moves[i-1];
+            }
+            m_moves[0] = move;
+            m_size++;
         }
 
         CMoveList& operator += (const CMoveList& rhs)
         {
-            m_moveList.insert(m_moveList.end(), rhs.m_moveList.begin(), rhs.m_moveList.end());
+            assert(m_size + rhs.m_size <= MAX_MOVES);
+            for (unsigned int i=0; i<rhs.m_size; ++i)
+            {
+                m_moves[m_size++] = rhs.m_moves[i];
+            }
             return *this;
         }
 
         CMoveList& operator = (const CMove& move)
         {
-            m_moveList.clear();
-            m_moveList.push_back(move);
+            m_moves[0] = move;
+            m_size = 1;
             return *this;
         }
 
         CMove last() const
         {
-            unsigned int size = m_moveList.size();
-            if (size)
+            if (m_size)
             {
-                return m_moveList[size-1];
+                return m_moves[m_size-1];
             }
             CMove move;
             return move;
@@ -76,25 +95,27 @@ class CMoveList
 
         void pop_back()
         {
-            m_moveList.pop_back();
+            assert(m_size > 0);
+            m_size--;
         }
 
         void clear()
         {
-            m_moveList.clear();
+            m_size = 0;
         }
 
         unsigned int size() const
         {
-            return m_moveList.size();
+            return m_size;
         }
 
-        const CMove & operator [] (unsigned int ix) const { return m_moveList[ix]; }
+        const CMove & operator [] (unsigned int ix) const { return m_moves[ix]; }
 
-        CMove & operator [] (unsigned int ix) { return m_moveList[ix]; }
+        CMove & operator [] (unsigned int ix) { return m_moves[ix]; }
 
     private:
-        std::vector<CMove> m_moveList;
+        CMove        m_moves[MAX_MOVES];
+        unsigned int m_size;
 
 }; /* end of CMoveList */
 
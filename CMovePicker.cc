@@ -0,0 +1,148 @@
+#include "CMovePicker.h"
+
+/***************************************************************
+ * isSpecial
+ * Returns true if the move has already been handed out, before
+ * the captures or quiet moves were generated.
+ ***************************************************************/
+bool CMovePicker::isSpecial(const CMove& move) const
+{
+    return move == m_hashMove || move == m_killers[0] || move == m_killers[1];
+} // end of isSpecial
+
+
+/***************************************************************
+ * isLosing
+ * Returns true if the capture loses material. The exchange is only
+ * evaluated, when the capturing piece is worth more than the victim.
+ ***************************************************************/
+bool CMovePicker::isLosing(const CMove& move) const
+{
+    if (move.is_it_a_promotion() || move.is_it_en_passant())
+        return false;
+
+    if (abs(m_board.movedPiece(move)) <= abs(m_board.capturedPiece(move)))
+        return false;
+
+    return m_board.see(move) < 0;
+} // end of isLosing
+
+
+/***************************************************************
+ * next
+ ***************************************************************/
+CMove CMovePicker::next()
+{
+    while (true)
+    {
+        switch (m_stage)
+        {
+            case STAGE_HASH :
+                m_stage = STAGE_GEN_CAPTURES;
+                // The hash move may come from a different position,
+                // in case of a hash collision. So it must be verified.
+                if (m_hashMove.Valid() && m_board.IsMoveValid(m_hashMove))
+                    return m_hashMove;
+                m_hashMove = CMove();
+                break;
+
+            case STAGE_GEN_CAPTURES :
+                m_board.find_captures(m_moves);
+                for (unsigned int i=0; i<m_moves.size(); ++i)
+                {
+                    // Most Valuable Victim - Least Valuable Attacker.
+                    // A promotion counts as capturing the promoted piece.
+                    const CMove& move = m_moves[i];
+                    int victim   = abs(m_board.capturedPiece(move)) + move.GetPromoted();
+                    int attacker = abs(m_board.movedPiece(move));
+                    if (move.is_it_en_passant())
+                        victim = WP;
+                    m_scores[i] = 8*victim - attacker;
+                }
+                m_index = 0;
+                m_stage = STAGE_CAPTURES;
+                break;
+
+            case STAGE_CAPTURES :
+                while (m_index < m_moves.size())
+                {
+                    // Selection sort. Only as much of the list is sorted
+                    // as is actually searched.
+                    unsigned int best = m_index;
+                    for (unsigned int i=m_index+1; i<m_moves.size(); ++i)
+                    {
+                        if (m_scores[i] > m_scores[best])
+                            best = i;
+                    }
+
+                    CMove move = m_moves[best];
+                    m_moves[best]  = m_moves[m_index];
+                    m_scores[best] = m_scores[m_index];
+                    m_index++;
+
+                    if (move == m_hashMove)
+                        continue;
+
+                    // Losing captures are searched last, or not at all
+                    // in the quiescence search.
+                    if (isLosing(move))
+                    {
+                        if (!m_capturesOnly)
+                            m_badCaptures.push_back(move);
+                        continue;
+                    }
+
+                    return move;
+                }
+                m_stage = m_capturesOnly ? (int) STAGE_DONE : (int) STAGE_KILLER1;
+                break;
+
+            case STAGE_KILLER1 :
+            case STAGE_KILLER2 :
+                {
+                    CMove& killer = m_killers[m_stage - STAGE_KILLER1];
+                    m_stage++;
+
+                    // The killer move is from a different position,
+                    // so it must be verified. Captures and promotions
+                    // are already searched.
+                    if (killer.Valid() && !(killer == m_hashMove)
+                            && m_board.IsMoveValid(killer)
+                            && !m_board.isCapture(killer)
+                            && !killer.is_it_a_promotion())
+                    {
+                        return killer;
+                    }
+                    killer = CMove();
+                }
+                break;
+
+            case STAGE_GEN_QUIETS :
+                m_board.find_quiets(m_moves);
+                m_index = 0;
+                m_stage = STAGE_QUIETS;
+                break;
+
+            case STAGE_QUIETS :
+                while (m_index < m_moves.size())
+                {
+                    const CMove& move = m_moves[m_index++];
+                    if (!isSpecial(move))
+                        return move;
+                }
+                m_index = 0;
+                m_stage = STAGE_BAD_CAPTURES;
+                break;
+
+            case STAGE_BAD_CAPTURES :
+                if (m_index < m_badCaptures.size())
+                    return m_badCaptures[m_index++];
+                m_stage = STAGE_DONE;
+                break;
+
+            default : // case STAGE_DONE :
+                return CMove();
+        }
+    }
+} // end of next
+
@@ -0,0 +1,73 @@
+#ifndef _CMOVEPICKER_H_
+#define _CMOVEPICKER_H_
+
+#include "CBoard.h"
+#include "CMoveList.h"
+
+/***************************************************************
+ * declaration of CMovePicker
+ *
+ * This hands out the legal moves of a position one at a time,
+ * in the order they should be searched:
+ * 1. The move from the hash table.
+ * 2. Captures, most valuable victim first, and of those the
+ *    least valuable attacker first (MVV-LVA).
+ * 3. The killer moves.
+ * 4. All remaining quiet moves.
+ * 5. Captures that lose material, according to the static
+ *    exchange evaluation (SEE).
+ *
+ * The moves are generated lazily, one stage at a time. If the
+ * search gets a cut-off early, the quiet moves are never generated.
+ *
+ * In the quiescence search only stage 2 is used, and promotions
+ * are included with the captures. The losing captures are pruned.
+ ***************************************************************/
+class CMovePicker
+{
+    public:
+        CMovePicker(const CBoard& board, const CMove& hashMove,
+                const CMove& killer1, const CMove& killer2)
+            : m_board(board), m_hashMove(hashMove), m_killers(), m_moves(), m_badCaptures(),
+            m_index(0), m_stage(STAGE_HASH), m_capturesOnly(false)
+            {m_killers[0] = killer1; m_killers[1] = killer2;}
+
+        // Used in the quiescence search.
+        CMovePicker(const CBoard& board)
+            : m_board(board), m_hashMove(), m_killers(), m_moves(), m_badCaptures(),
+            m_index(0), m_stage(STAGE_GEN_CAPTURES), m_capturesOnly(true)
+            {}
+
+        // Returns an invalid move, when there are no more moves.
+        CMove next();
+
+    private:
+        enum
+        {
+            STAGE_HASH,
+            STAGE_GEN_CAPTURES,
+            STAGE_CAPTURES,
+            STAGE_KILLER1,
+            STAGE_KILLER2,
+            STAGE_GEN_QUIETS,
+            STAGE_QUIETS,
+            STAGE_BAD_CAPTURES,
+            STAGE_DONE
+        };
+
+        bool isSpecial(const CMove& move) const;
+        bool isLosing(const CMove& move) const;
+
+        const CBoard& m_board;
+        CMove         m_hashMove;
+        CMove         m_killers[2];
+        CMoveList     m_moves;
+        CMoveList     m_badCaptures;
+        int           m_scores[MAX_MOVES]; // Not initialized, only used after generation.
+        unsigned int  m_index;
+        int           m_stage;
+        bool          m_capturesOnly;
+}; /* end of CMovePicker */
+
+#endif // _CMOVEPICKER_H_
+
@@ -13,7 +13,6 @@ void CPerft::clear()
 {
     m_nodes = 0;
     m_leafnodes = 0;
-    m_hashEntry.set(m_board);
 } // end of clear
 
 
@@ -39,30 +38,25 @@ void CPerft::search(int level)
         CMove move = moves[i];
 #ifdef DEBUG_HASH
         uint32_t oldHash = m_board.calcHash();
-        CHashEntry hashCopy(m_hashEntry);
+        uint64_t oldKey = m_board.hashKey();
 #endif
-        m_hashEntry.update(m_board, move);
-        m_board.make_move(move);
+        t_undo& undo = m_undo[m_moveList.size()];
+        m_board.make_move(move, undo);
         m_moveList.push_back(move);
 #ifdef DEBUG_HASH
         {
-            CHashEntry m_newHash;
-            m_newHash.set(m_board);
-            if (m_newHash != m_hashEntry)
+            uint64_t newKey = m_board.calcHashKey();
+            if (newKey != m_board.hashKey())
             {
-                TRACE(m_moveList.ToLongString() << std::endl);
-                TRACE("New hash failure(2):" << std::hex << (m_newHash ^ m_hashEntry) << std::endl);
+                TRACE(m_moveList.ToShortString() << std::endl);
+                TRACE("New hash failure(2):" << std::hex << (newKey ^ m_board.hashKey()) << std::endl);
                 TRACE(m_board);
                 assert(false);
             }
         }
 #endif
-        if (!m_board.isOtherKingInCheck())
-        {
-            search(level-1);
-        }
-        m_board.undo_move(move);
-        m_hashEntry.update(m_board, move);
+        search(level-1);
+        m_board.undo_move(move, undo);
         m_moveList.pop_back();
 #ifdef DEBUG_HASH
         uint32_t newHash = m_board.calcHash();
@@ -72,7 +66,7 @@ void CPerft::search(int level)
             TRACE(m_board);
             assert(false);
         }
-        if (hashCopy != m_hashEntry)
+        if (oldKey != m_board.hashKey())
         {
             TRACE("New hash failure" << std::endl);
             TRACE(m_board);
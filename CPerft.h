@@ -11,7 +11,7 @@ class CPerft
         friend std::ostream& operator <<(std::ostream &os, const CPerft &rhs);
 
         CPerft(const CBoard &board) : m_board(board), m_nodes(), m_leafnodes(),
-            m_moveList(), m_hashEntry() {clear();}
+            m_moveList(), m_undo() {clear();}
 
         void clear();
         void search(int level);
@@ -24,7 +24,7 @@ class CPerft
         unsigned long m_nodes;
         unsigned long m_leafnodes;
         CMoveList     m_moveList;
-        CHashEntry    m_hashEntry;
+        t_undo        m_undo[MAX_PLY];
 
 }; // end of class CPerft
 
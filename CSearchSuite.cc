@@ -44,6 +44,11 @@ std::string CSearchSuite::ToString() const
     std::stringstream ss;
     ss << m_passCount << " test cases passed!" << std::endl;
     ss << m_failCount << " test cases failed!" << std::endl;
+    ss << m_nodes << " nodes in " << m_millisecs << " ms";
+    if (m_millisecs)
+        ss << ", " << (m_nodes*1000)/m_millisecs << " nodes per second";
+    ss << std::endl;
+    ss << m_hashHits << " hash hits in " << m_hashProbes << " probes" << std::endl;
     return ss.str();
 } // end of ToString
 
@@ -60,6 +65,8 @@ bool CSearchSuite::DoTest()
         return true;
     }
 
+    CTime timeStart;
+
     while (true)
     {
         std::string line;
@@ -152,6 +159,10 @@ bool CSearchSuite::DoTest()
         } // while (*p)
 
         CMove best_move = m_ai.find_best_move(60*1000, 60*1000, 1); // Search for one minute
+        m_millisecs   = CTimeDiff(timeStart).millisecs(); // Short searches are timed together
+        m_nodes      += m_ai.nodes();
+        m_hashProbes += m_ai.hashProbes();
+        m_hashHits   += m_ai.hashHits();
 
         m_testSuiteLogFile << id << " : " << best_move << " : "; 
 
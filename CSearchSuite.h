@@ -12,6 +12,7 @@ class CSearchSuite
         friend std::ostream& operator <<(std::ostream &os, const CSearchSuite &rhs);
 
         CSearchSuite(const char *fileName) : m_passCount(0), m_failCount(0),
+            m_nodes(0), m_millisecs(0), m_hashProbes(0), m_hashHits(0),
             m_testSuiteFile(), m_testSuiteLogFile(), m_board(), m_ai(m_board)
             {open(fileName);}
         ~CSearchSuite() {close();}
@@ -23,6 +24,10 @@ class CSearchSuite
     private:
         int           m_passCount;
         int           m_failCount;
+        unsigned long m_nodes;      // Totals of all the searches, so the
+        unsigned long m_millisecs;  // suite also serves as a benchmark.
+        unsigned long m_hashProbes;
+        unsigned long m_hashHits;
         std::ifstream m_testSuiteFile;
         std::ofstream m_testSuiteLogFile;
         CBoard        m_board;
@@ -7,22 +7,23 @@
 // Useful enumerations to conveniently address specific squares on the board
 enum // Squares
 {
-    A8 = 91, B8, C8, D8, E8, F8, G8, H8,
-    A7 = 81, B7, C7, D7, E7, F7, G7, H7,
-    A6 = 71, B6, C6, D6, E6, F6, G6, H6,
-    A5 = 61, B5, C5, D5, E5, F5, G5, H5,
-    A4 = 51, B4, C4, D4, E4, F4, G4, H4,
-    A3 = 41, B3, C3, D3, E3, F3, G3, H3,
-    A2 = 31, B2, C2, D2, E2, F2, G2, H2,
-    A1 = 21, B1, C1, D1, E1, F1, G1, H1
+    A8 = 56, B8, C8, D8, E8, F8, G8, H8,
+    A7 = 48, B7, C7, D7, E7, F7, G7, H7,
+    A6 = 40, B6, C6, D6, E6, F6, G6, H6,
+    A5 = 32, B5, C5, D5, E5, F5, G5, H5,
+    A4 = 24, B4, C4, D4, E4, F4, G4, H4,
+    A3 = 16, B3, C3, D3, E3, F3, G3, H3,
+    A2 =  8, B2, C2, D2, E2, F2, G2, H2,
+    A1 =  0, B1, C1, D1, E1, F1, G1, H1
 };
 
 /***************************************************************
  * declaration of CSquare 
  *
  * This class encapsulates the notion of a square.
- * This class converts between an internal (0 - 119)
+ * This class converts between an internal (0 - 63)
  * and a (column,row) representation.
+ * The internal number is also the bit number used in bitboards.
  ***************************************************************/
 
 class CSquare 
@@ -32,21 +33,19 @@ class CSquare
             m_sq(square) {}
 
         CSquare(uint32_t col, uint32_t row) :
-            m_sq(row*10 + col + 21) {}
+            m_sq(row*8 + col) {}
 
         operator int() const { return m_sq; } // Implicit conversion to integer
 
-        bool isValid() const { return 
-            (m_sq % 10) >= 1 && (m_sq % 10) <= 8
-                && (m_sq / 10) >= 2 && (m_sq / 10) <= 9; }
+        bool isValid() const { return m_sq < 64; }
 
-        int row() const {return (m_sq/10) - 1;} // returns 1 - 8
-        int col() const {return (m_sq%10);}     // returns 1 - 8
+        int row() const {return (m_sq/8) + 1;} // returns 1 - 8
+        int col() const {return (m_sq%8) + 1;} // returns 1 - 8
 
         friend std::ostream& operator <<(std::ostream &os, const CSquare &rhs)
         {
-            char c = (rhs.m_sq%10) + 'a' - 1;
-            char r = (rhs.m_sq/10) + '1' - 2;
+            char c = (rhs.m_sq%8) + 'a';
+            char r = (rhs.m_sq/8) + '1';
             return os << c << r;
         }
 
@@ -54,13 +53,13 @@ class CSquare
         {
             uint32_t col = s[0] - 'a';
             uint32_t row = s[1] - '1';
-            m_sq = row*10 + col + 21;
+            m_sq = row*8 + col;
             return (col >= 8 || row >= 8);
             // Returns true if error
         }
 
     private:
-        uint8_t  m_sq; // Internal representation, 0 - 119.
+        uint8_t  m_sq; // Internal representation, 0 - 63.
 }; /* end of class CSquare */
 
 #endif // _C_SQUARE_H_
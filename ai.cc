@@ -5,6 +5,7 @@
 #include "ai.h"
 #include "trace.h"
 #include "CTime.h"
+#include "CMovePicker.h"
 
 const int INFINITY = 9999;
 
@@ -29,18 +30,16 @@ const int INFINITY = 9999;
  ***************************************************************/
 int AI::search(int alpha, int beta, int level, CMoveList& pv)
 {
-    // Check for illegal position (side NOT to move is in check).
-    // In other words, the side to move can capture the opponents position.
-    // This is an illegal position but corresponds to an immediate win.
-    // Return a large positive value.
-    if (m_board.isOtherKingInCheck())
+    TRACE("(" << alpha << "," << beta << ") " << m_moveList << ": ");
+
+    // A drawn position needs no search. Since the score does not
+    // depend on the moves, nothing is stored in the hash table.
+    if (isDraw())
     {
-        TRACE("S : " << 9000 + level << std::endl);
-        return 9000 + level;
+        TRACE("S : draw" << std::endl);
+        return 0;
     }
 
-    TRACE("(" << alpha << "," << beta << ") " << m_moveList << ": ");
-
     // First we check if we are at leaf of tree.
     // If so, do a quiescence search.
     if (level == 0)
@@ -68,14 +67,12 @@ int AI::search(int alpha, int beta, int level, CMoveList& pv)
             }
 
             hashEntry.m_nodeTypeAndLevel.level = level;
-            hashEntry.m_hashValue              = m_hashEntry.m_hashValue;
+            hashEntry.m_hashValue              = m_board.hashKey();
             hashEntry.m_searchValue            = val;
             hashEntry.m_bestMove               = pv[0];
 
             m_hashTable.insert(hashEntry);
             TRACE("Added quiet hashEntry : " << m_moveList << " " << hashEntry << std::endl);
-
-            m_killerMove = pv[0];
         }
 
         return val;
@@ -89,8 +86,10 @@ int AI::search(int alpha, int beta, int level, CMoveList& pv)
     // transpositions, but that is less frequent.
     // The main benefit is that it gives a good move to search first.
     CHashEntry hashEntry;
-    if (m_hashTable.find(m_hashEntry.m_hashValue, hashEntry))
+    m_hashProbes++;
+    if (m_hashTable.find(m_board.hashKey(), hashEntry))
     {
+        m_hashHits++;
         TRACE("Found hashEntry : " << hashEntry);
 
         // Now we examine the search value stored.
@@ -129,69 +128,64 @@ int AI::search(int alpha, int beta, int level, CMoveList& pv)
 
     TRACE(std::endl);
 
-    // Prepare to search through all legal moves.
-    CMoveList moves;
-    m_board.find_legal_moves(moves);
-
-    // If we have been at this position before, which move was the best?
-    // Search this move first, because it is likely to still be the best.
-    // This often provides a quick refutation of the previous move, 
+    // The moves are searched in the order given by the move picker:
+    // If we have been at this position before, the best move from then
+    // is searched first, because it is likely to still be the best.
+    // This often provides a quick refutation of the previous move,
     // and therefore saves a lot of time.
-    if (hashEntry.m_bestMove.Valid())
-    {
-        for (unsigned int i=0; i<moves.size(); ++i)
-        {
-            if (moves[i] == hashEntry.m_bestMove)
-            {
-                TRACE("Hash: Move reordering! Play " << hashEntry.m_bestMove
-                        << " first" << std::endl);
-                moves[i] = moves[0];
-                moves[0] = hashEntry.m_bestMove;
-                break;
-            }
-        }
-    }
-    else
-    { // Search captures first.
-        unsigned int j=0;
-        for (unsigned int i=0; i<moves.size(); ++i)
-        {
-            if (moves[i].is_it_a_capture())
-            {
-                CMove tmpMove = moves[i];
-                moves[i] = moves[j];
-                moves[j] = tmpMove;
-
-                TRACE("Capture: Move reordering! Play " << tmpMove
-                        << " first" << std::endl);
-                j++;
-            }
-        }
-    }
+    // Then follow the captures, the killer moves, and the quiet moves.
+    unsigned int ply = m_moveList.size();
+    CMovePicker picker(m_board, hashEntry.m_bestMove,
+            m_killers[ply][0], m_killers[ply][1]);
 
     int best_val = -INFINITY;
     int alpha_orig = alpha;
 
     // Loop through all legal moves.
-    for (unsigned int i=0; i<moves.size(); ++i)
+    unsigned int numMoves = 0;
+    CMove move;
+    while ((move = picker.next()).Valid())
     {
-        CMove move = moves[i];
+        numMoves++;
 
 #ifdef DEBUG_HASH
         uint32_t oldHash = m_board.calcHash();
-        CHashEntry hashCopy(m_hashEntry);
+        uint64_t oldKey = m_board.hashKey();
 #endif
 
         // Do a recursive search
+#ifdef COPY_MAKE
+        CBoard parent(m_board);
+#endif
+#ifndef NO_PREFETCH
+        // The child position will look itself up in the hash table,
+        // so the entry is fetched from memory while the move is made.
+        m_hashTable.prefetch(m_board.hashKeyAfter(move));
+#endif
+
+        t_undo& undo = m_undo[ply];
         m_moveList.push_back(move);
-        m_hashEntry.update(m_board, move);
-        m_board.make_move(move);
+        m_board.make_move(move, undo);
+        m_history.push_back(m_board.hashKey());
+
+#ifdef DEBUG_HASH
+        if (m_board.hashKey() != m_board.calcHashKey())
+        {
+            TRACE("Incremental hash failure" << std::endl);
+            TRACE(m_board);
+            exit(-1);
+        }
+#endif
 
         CMoveList pv_temp;
         int val = -search(-beta, -alpha, level-1, pv_temp);
 
-        m_board.undo_move(move);
-        m_hashEntry.update(m_board, move);
+        m_history.pop_back();
+#ifdef COPY_MAKE
+        m_board = parent;
+#else
+        m_board.undo_move(move, undo);
+#endif
         m_moveList.pop_back();
 
 #ifdef DEBUG_HASH
@@ -202,7 +196,7 @@ int AI::search(int alpha, int beta, int level, CMoveList& pv)
             TRACE(m_board);
             exit(-1);
         }
-        if (hashCopy != m_hashEntry)
+        if (oldKey != m_board.hashKey() || oldKey != m_board.calcHashKey())
         {
             TRACE("New hash failure" << std::endl);
             TRACE(m_board);
@@ -230,6 +224,15 @@ int AI::search(int alpha, int beta, int level, CMoveList& pv)
         // If so, then stop the search.
         if (alpha >= beta)
         {
+            // A quiet move that causes a cut-off is likely to do so
+            // in the sibling positions too. Remember it as a killer move.
+            if (!m_board.isCapture(move) && !move.is_it_a_promotion()
+                    && !(move == m_killers[ply][0]))
+            {
+                m_killers[ply][1] = m_killers[ply][0];
+                m_killers[ply][0] = move;
+            }
+
             // This is fail-soft, since we are returning the value best_val,
             // which might be outside the window.
             break;
@@ -245,13 +248,19 @@ int AI::search(int alpha, int beta, int level, CMoveList& pv)
             }
         }
 
-    } // end of for
+    } // end of while
 
-    // If our king was captured, check for stalemate
-    if (best_val < -8000)
+    // If there are no legal moves, the game is over.
+    // A checkmate is scored higher, the sooner it happens.
+    if (numMoves == 0)
     {
-        if (!m_board.isKingInCheck())
-            best_val = 0;
+        if (m_board.isKingInCheck())
+        {
+            TRACE("S : checkmate" << std::endl);
+            return -(9000 + level);
+        }
+        TRACE("S : stalemate" << std::endl);
+        return 0;
     }
 
     // Finally, store the result in the hash table.
@@ -271,7 +280,7 @@ int AI::search(int alpha, int beta, int level, CMoveList& pv)
     }
 
     hashEntry.m_nodeTypeAndLevel.level = level;
-    hashEntry.m_hashValue              = m_hashEntry.m_hashValue;
+    hashEntry.m_hashValue              = m_board.hashKey();
     hashEntry.m_searchValue            = best_val;
     hashEntry.m_bestMove               = pv[0];
 
@@ -281,6 +290,49 @@ int AI::search(int alpha, int beta, int level, CMoveList& pv)
     return best_val;
 } // end of int search
 
+/***************************************************************
+ * isDraw
+ * Returns true if the current position is a draw, either by
+ * repetition, by the 50-move rule, or by insufficient material.
+ * A checkmated side is not saved by the 50-move rule.
+ * A single repetition counts, because if it is good to repeat the
+ * position once, then it is good to repeat it again.
+ * The current position is the last one in m_history.
+ ***************************************************************/
+bool AI::isDraw() const
+{
+    // A checkmate on the move that completes the 50 moves still counts.
+    // The search then finds no legal moves, and scores the mate.
+    if (m_board.halfMoves() >= 100)
+    {
+        if (!m_board.isKingInCheck())
+            return true;
+
+        CMoveList moves;
+        m_board.find_legal_moves(moves);
+        return moves.size() > 0;
+    }
+
+    if (m_board.isInsufficientMaterial())
+        return true;
+
+    // Only positions since the last capture or pawn move can repeat,
+    // and only those with the same side to move.
+    int last  = m_history.size() - 1;
+    int first = last - m_board.halfMoves();
+    if (first < 0)
+        first = 0;
+
+    for (int i = last-4; i >= first; i -= 2)
+    {
+        if (m_history[i] == m_history[last])
+            return true;
+    }
+
+    return false;
+} // end of isDraw
+
+
 /***************************************************************
  * This performs a search of capture moves only.
  * The static evaluation is used as a lower bound on the score.
@@ -291,16 +343,6 @@ int AI::quiescence(int alpha, int beta, CMoveList& pv)
 {
     pv.clear();
 
-    // Check for illegal position (side NOT to move is in check).
-    // In other words, the side to move can capture the opponents position.
-    // This is an illegal position but corresponds to an immediate win.
-    // Return a large positive value.
-    if (m_board.isOtherKingInCheck())
-    {
-        TRACE("Q : 9000" << std::endl);
-        return 9000;
-    }
-
     m_nodes++;
 
     int best_val = m_board.get_value();
@@ -314,81 +356,33 @@ int AI::quiescence(int alpha, int beta, CMoveList& pv)
     if (best_val > alpha)
         alpha = best_val;
 
-    CMoveList moves;
-    m_board.find_legal_moves(moves);
-
-    // Search killer move first
-    unsigned int j=0;
-    if (m_killerMove.Valid())
-    {
-        for (unsigned int i=0; i<moves.size(); ++i)
-        {
-            if (moves[i] == m_killerMove && moves[i].is_it_a_capture())
-            {
-                CMove tmpMove = moves[i];
-                moves[i] = moves[j];
-                moves[j] = tmpMove;
-
-                TRACE("Killer move reordering! Play " << tmpMove
-                        << " first" << std::endl);
-                j++;
-            }
-        }
-    } // end of if lastMove.Valid()
-
-    // Search recaptures to same square first.
-    CMove lastMove = m_moveList.last();
-    if (lastMove.Valid())
-    {
-        for (unsigned int i=j; i<moves.size(); ++i)
-        {
-            if (moves[i].To() == lastMove.To())
-            {
-                CMove tmpMove = moves[i];
-                moves[i] = moves[j];
-                moves[j] = tmpMove;
-
-                TRACE("Recapture move reordering! Play " << tmpMove
-                        << " first" << std::endl);
-                j++;
-            }
-        }
-    } // end of if lastMove.Valid()
-
-    // Search piece captures first.
-    for (unsigned int i=j; i<moves.size(); ++i)
-    {
-        if (moves[i].GetCaptured() != WP && 
-                moves[i].GetCaptured() != BP && 
-                moves[i].GetCaptured() != EM)
-        {
-            CMove tmpMove = moves[i];
-            moves[i] = moves[j];
-            moves[j] = tmpMove;
+    unsigned int ply = m_moveList.size();
+    if (ply >= MAX_PLY)
+        return best_val;
 
-            TRACE("Piece capture move reordering! Play " << tmpMove
-                    << " first" << std::endl);
-            j++;
-        }
-    }
+    // Only captures and promotions are searched, with the most
+    // valuable victim first.
+    CMovePicker picker(m_board);
 
-    for (unsigned int i=0; i<moves.size(); ++i)
+    CMove move;
+    while ((move = picker.next()).Valid())
     {
-        CMove move = moves[i];
-
-        if (!move.is_it_a_capture())
-            continue; // Skip non-captures
-
         // Do a recursive search
+#ifdef COPY_MAKE
+        CBoard parent(m_board);
+#endif
+        t_undo& undo = m_undo[ply];
         m_moveList.push_back(move);
-        m_hashEntry.update(m_board, move);
-        m_board.make_move(move);
+        m_board.make_move(move, undo);
 
         CMoveList pv_temp;
         int val = -quiescence(-beta, -alpha, pv_temp);
 
-        m_board.undo_move(move);
-        m_hashEntry.update(m_board, move);
+#ifdef COPY_MAKE
+        m_board = parent;
+#else
+        m_board.undo_move(move, undo);
+#endif
         m_moveList.pop_back();
 
         if (val > best_val)
@@ -411,7 +405,7 @@ int AI::quiescence(int alpha, int beta, CMoveList& pv)
         {
             break; // fail-soft
         }
-    } // end of for
+    } // end of while
 
     return best_val;
 } // end of quiescence
@@ -426,8 +420,14 @@ int AI::quiescence(int alpha, int beta, CMoveList& pv)
 CMove AI::find_best_move(int wTime, int bTime, int movesToGo)
 {
     m_nodes = 0;
-    m_hashEntry.set(m_board);
+    m_hashProbes = 0;
+    m_hashHits = 0;
     m_moveList.clear();
+    m_hashTable.newSearch();
+
+    // Without a game history, the search starts a new history.
+    if (m_history.empty() || m_history.back() != m_board.hashKey())
+        m_history.assign(1, m_board.hashKey());
 
     CTime timeStart;
     m_timeEnd = timeStart;
@@ -446,6 +446,13 @@ CMove AI::find_best_move(int wTime, int bTime, int movesToGo)
     CMoveList moves;
     m_board.find_legal_moves(moves);
 
+    // No legal moves means checkmate or stalemate.
+    // Return an invalid move.
+    if (moves.size() == 0)
+    {
+        return CMove();
+    }
+
     CMoveList best_moves;
 
     int best_val;
@@ -477,15 +484,16 @@ CMove AI::find_best_move(int wTime, int bTime, int movesToGo)
 
             CMove move = moves[i];
 
+            t_undo& undo = m_undo[0];
             m_moveList.push_back(move);
-            m_hashEntry.update(m_board, move);
-            m_board.make_move(move);
+            m_board.make_move(move, undo);
+            m_history.push_back(m_board.hashKey());
 
             CMoveList pv_temp;
             int val = -search(-beta, -alpha, level, pv_temp);
 
-            m_board.undo_move(move);
-            m_hashEntry.update(m_board, move);
+            m_history.pop_back();
+            m_board.undo_move(move, undo);
             m_moveList.pop_back();
 
             TRACE("]" << alpha << ", " << beta << "[ "
@@ -551,6 +559,7 @@ CMove AI::find_best_move(int wTime, int bTime, int movesToGo)
 
         std::cout << "info depth " << level << " score cp " << best_val;
         std::cout << " time " << millisecs << " nodes " << m_nodes << " nps " << nps;
+        std::cout << " hashfull " << m_hashTable.hashFull();
         std::cout << " pv " << pv << std::endl;
 
         CTime now;
@@ -563,6 +572,9 @@ CMove AI::find_best_move(int wTime, int bTime, int movesToGo)
         level += 2;
     }
 
+    std::cout << "info string Hash probes " << m_hashProbes
+              << " hits " << m_hashHits << std::endl;
+
     CMove move = best_moves[rand()%num_good];
 
     TRACE(num_good << " moves to choose from" << std::endl);
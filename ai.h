@@ -1,6 +1,8 @@
 #ifndef _AI_H_
 #define _AI_H_
 
+#include <vector>
+
 #include "CBoard.h"
 #include "CMoveList.h"
 #include "CHashTable.h"
@@ -9,24 +11,43 @@
 class AI
 {
 public:
-    AI(CBoard& board) : m_board(board), m_nodes(), m_hashTable(), m_hashEntry(),
-        m_moveList(), m_timeEnd(), m_pvSearch(), m_killerMove()
+    AI(CBoard& board) : m_board(board), m_nodes(), m_hashProbes(), m_hashHits(), m_hashTable(),
+        m_moveList(), m_timeEnd(), m_pvSearch(), m_killers(), m_undo(), m_history()
         {m_moveList.clear();}
 
     CMove find_best_move(int wTime = 0, int bTime = 0, int movesToGo = 0);
 
+    // The hash keys of all positions in the game so far, the current
+    // position last. This is needed to detect draws by repetition.
+    void setHistory(const std::vector<uint64_t>& keys) {m_history = keys;}
+
+    // The size of the transposition table is given in megabytes.
+    // Returns the size actually allocated.
+    size_t setHashSize(size_t megaBytes) {return m_hashTable.resize(megaBytes);}
+    void   clearHash() {m_hashTable.clear();}
+    const char *hashPages() const {return m_hashTable.pages();}
+
+    // Statistics of the last search.
+    unsigned long nodes() const      {return m_nodes;}
+    unsigned long hashProbes() const {return m_hashProbes;}
+    unsigned long hashHits() const   {return m_hashHits;}
+
 private:
     int search(int alpha, int beta, int level, CMoveList& pv);
     int quiescence(int alpha, int beta, CMoveList& pv);
+    bool isDraw() const;
 
     CBoard&         m_board;
     unsigned long   m_nodes;
+    unsigned long   m_hashProbes;
+    unsigned long   m_hashHits;
     CHashTable      m_hashTable;
-    CHashEntry      m_hashEntry;
     CMoveList       m_moveList;
     CTime           m_timeEnd;
     bool            m_pvSearch;
-    CMove           m_killerMove;
+    CMove           m_killers[MAX_PLY][2]; // Quiet moves that caused a cut-off, per ply.
+    t_undo          m_undo[MAX_PLY];
+    std::vector<uint64_t> m_history; // Game history, followed by the current line of the search.
 }; // end of class AI
 
 #endif // _AI_H_
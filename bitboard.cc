@@ -0,0 +1,406 @@
+#include "bitboard.h"
+
+bitboard_t knightAttacks[64];
+bitboard_t kingAttacks[64];
+bitboard_t pawnAttacks[2][64];
+bitboard_t bishopRays[64];
+bitboard_t rookRays[64];
+bitboard_t betweenBB[64][64];
+bitboard_t lineBB[64][64];
+
+t_magic rookMagics[64];
+t_magic bishopMagics[64];
+
+// Shared attack tables for all squares.
+static bitboard_t rookTable[0x19000];  // 102400 entries
+static bitboard_t bishopTable[0x1480]; //   5248 entries
+
+static const int rookDirs[4][2]   = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+static const int bishopDirs[4][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+
+/***************************************************************
+ * step
+ * Returns the square reached by moving (dcol,drow) from sq,
+ * or -1 if it is outside the board.
+ ***************************************************************/
+static int step(int sq, int dcol, int drow)
+{
+    int col = sq%8 + dcol;
+    int row = sq/8 + drow;
+    if (col < 0 || col > 7 || row < 0 || row > 7)
+        return -1;
+    return row*8 + col;
+} // end of step
+
+
+/***************************************************************
+ * slidingAttacks
+ * Calculates the attack set the slow way, by following each ray
+ * until it hits an occupied square. Only used during initialization.
+ ***************************************************************/
+static bitboard_t slidingAttacks(int sq, bitboard_t occupied, const int dirs[4][2])
+{
+    bitboard_t attacks = 0;
+
+    for (int k=0; k<4; ++k)
+    {
+        int sq2 = sq;
+        while ((sq2 = step(sq2, dirs[k][0], dirs[k][1])) >= 0)
+        {
+            attacks |= bb_square(sq2);
+            if (occupied & bb_square(sq2))
+                break;
+        }
+    }
+
+    return attacks;
+} // end of slidingAttacks
+
+
+/***************************************************************
+ * Magic multipliers. These were found by trial and error, using
+ * sparse random numbers, so that every relevant occupancy maps
+ * to an index without destructive collisions.
+ ***************************************************************/
+static const bitboard_t rookMagicNumbers[64] = {
+    0x0080068051E04000ULL, 0x0040001000402000ULL, 0x0080100020008008ULL, 0x4E000A0010208440ULL,
+    0x4200040802002010ULL, 0x0100010008020400ULL, 0x9080608019000600ULL, 0x8100020080204100ULL,
+    0x4103800480400020ULL, 0x8015004004802100ULL, 0x000200108A002040ULL, 0x0801000821001000ULL,
+    0x0015000500080070ULL, 0x0120800400800200ULL, 0x0109000432001100ULL, 0x020080055B000080ULL,
+    0x0080004000402002ULL, 0x5260848020004008ULL, 0x2402020014402080ULL, 0x3000808010000802ULL,
+    0x0304018004810800ULL, 0x0000808004000200ULL, 0x0002040001500248ULL, 0x0012020000408401ULL,
+    0x8440008080004020ULL, 0x0804200840100040ULL, 0x0820008080201000ULL, 0x2080100100082100ULL,
+    0x0001000500100800ULL, 0x00A1000900028400ULL, 0x0100100400C80102ULL, 0x000001120000A044ULL,
+    0x800080C004800620ULL, 0x4040081000202000ULL, 0x0D08802008801000ULL, 0x1000800800801004ULL,
+    0x1004000801010010ULL, 0x0402800400800200ULL, 0x0004080204008110ULL, 0x0000404082000401ULL,
+    0x00C0118861408000ULL, 0x1100220081020048ULL, 0x09A0430420050010ULL, 0x0000082200420010ULL,
+    0x2110080004008080ULL, 0x2004201040680104ULL, 0x1106001451820008ULL, 0x0002224104820014ULL,
+    0x00800C8044210500ULL, 0x02A0200040100040ULL, 0x040100A0001E4100ULL, 0x00204023108A0200ULL,
+    0x2400080080040080ULL, 0x1289008400020900ULL, 0x0002088250010400ULL, 0x0001006084010200ULL,
+    0x0001023480002141ULL, 0x0006400021810015ULL, 0x8400100840200101ULL, 0x40003000A1000825ULL,
+    0x1002011008200402ULL, 0x100D000400080201ULL, 0x0020048806102904ULL, 0x8401000020804201ULL
+};
+
+static const bitboard_t bishopMagicNumbers[64] = {
+    0x0842244818044480ULL, 0x0084B02220410210ULL, 0x0008180060801200ULL, 0x8204104210048000ULL,
+    0x4002121007804021ULL, 0x0102020220400000ULL, 0x000404040B190050ULL, 0x0089008210020208ULL,
+    0xA208041004014402ULL, 0xD088908202004610ULL, 0x0088083250420010ULL, 0x0048040410904801ULL,
+    0x0002011040020000ULL, 0x8000031002900840ULL, 0x0504041101082204ULL, 0x4440804208010818ULL,
+    0x6120084002022210ULL, 0x09420D1090010920ULL, 0x8028004500440085ULL, 0x0C140208401020A0ULL,
+    0x8001000820080000ULL, 0x000040020100A000ULL, 0x801240008C108820ULL, 0x0048410092080108ULL,
+    0xE023204048281001ULL, 0x4004100A20024080ULL, 0x0004100006410242ULL, 0x0010104014040002ULL,
+    0x0002040012009040ULL, 0x0008204062010080ULL, 0x002401000090B000ULL, 0x3000802005010800ULL,
+    0x0810108804900200ULL, 0x0002100242040880ULL, 0x0002E11008110400ULL, 0x0201010800050040ULL,
+    0x8108020400801100ULL, 0x8801020408220109ULL, 0x00010A0224008808ULL, 0x2008411020210080ULL,
+    0x9014241444004004ULL, 0x001041088801A052ULL, 0x0010202030041801ULL, 0x0080004208000080ULL,
+    0x0000420202004410ULL, 0x4001010101004201ULL, 0x00280D0848800202ULL, 0x0010840080892020ULL,
+    0x0028841023100010ULL, 0xA011010090048061ULL, 0x8211210405240041ULL, 0x0000000041108200ULL,
+    0x40820030020A0700ULL, 0x211040021C451128ULL, 0x2014540888130C00ULL, 0x0012280903020000ULL,
+    0x1002120104124000ULL, 0x01005C220222A004ULL, 0x0080004202010420ULL, 0x0048100040208810ULL,
+    0x0000000004218600ULL, 0x4000200520040100ULL, 0x0104066042040104ULL, 0x0C40080810404044ULL
+};
+
+
+/***************************************************************
+ * initMagics
+ * Fills in the magic entries and attack tables for one slider.
+ ***************************************************************/
+static void initMagics(t_magic magics[64], bitboard_t *table, const int dirs[4][2],
+        const bitboard_t magicNumbers[64])
+{
+    for (int sq=0; sq<64; ++sq)
+    {
+        t_magic& m = magics[sq];
+
+        // The board edges are irrelevant, unless the piece is on that edge.
+        bitboard_t edges = ((RANK_1 | RANK_8) & ~(RANK_1 << (8*(sq/8))))
+                         | ((FILE_A | FILE_H) & ~(FILE_A << (sq%8)));
+
+        m.mask    = slidingAttacks(sq, 0, dirs) & ~edges;
+        m.magic   = magicNumbers[sq];
+        m.shift   = 64 - bb_count(m.mask);
+        m.attacks = table;
+
+        // Enumerate all subsets of the mask (Carry-Rippler trick).
+        int size = 0;
+        bitboard_t b = 0;
+        do
+        {
+            m.attacks[magic_index(m, b)] = slidingAttacks(sq, b, dirs);
+            size++;
+            b = (b - m.mask) & m.mask;
+        } while (b);
+
+        table += size;
+    }
+} // end of initMagics
+
+
+/***************************************************************
+ * Kogge-Stone fills.
+ * Each direction is a shift and a mask of the squares that do not
+ * wrap around to the opposite file. Directions up the board shift
+ * left, and directions down the board shift right. The four lanes
+ * hold the directions N, E, NE, NW (shifting left), and S, W, SW, SE
+ * (shifting right), so the two halves use the same shift amounts.
+ ***************************************************************/
+static const int        fillShift[4] = {8, 1, 9, 7};
+static const bitboard_t fillMaskUp[4]   = {~0ULL, ~FILE_A, ~FILE_A, ~FILE_H};
+static const bitboard_t fillMaskDown[4] = {~0ULL, ~FILE_H, ~FILE_H, ~FILE_A};
+
+
+/***************************************************************
+ * fillUp / fillDown
+ * Returns the attacks in one direction of all pieces in 'gen'.
+ * 'pro' is the set of empty squares, that the fill may pass.
+ ***************************************************************/
+static inline bitboard_t fillUp(bitboard_t gen, bitboard_t pro, int s, bitboard_t mask)
+{
+    pro &= mask;
+    gen |= pro & (gen << s);
+    pro &=        pro << s;
+    gen |= pro & (gen << 2*s);
+    pro &=        pro << 2*s;
+    gen |= pro & (gen << 4*s);
+    return (gen << s) & mask;
+} // end of fillUp
+
+static inline bitboard_t fillDown(bitboard_t gen, bitboard_t pro, int s, bitboard_t mask)
+{
+    pro &= mask;
+    gen |= pro & (gen >> s);
+    pro &=        pro >> s;
+    gen |= pro & (gen >> 2*s);
+    pro &=        pro >> 2*s;
+    gen |= pro & (gen >> 4*s);
+    return (gen >> s) & mask;
+} // end of fillDown
+
+
+/***************************************************************
+ * sliderAttacksScalar
+ ***************************************************************/
+static bitboard_t sliderAttacksScalar(bitboard_t rooks, bitboard_t bishops, bitboard_t occupied)
+{
+    bitboard_t empty   = ~occupied;
+    bitboard_t attacks = 0;
+
+    for (int k=0; k<4; ++k)
+    {
+        bitboard_t gen = (k < 2) ? rooks : bishops;
+        attacks |= fillUp(gen, empty, fillShift[k], fillMaskUp[k]);
+        attacks |= fillDown(gen, empty, fillShift[k], fillMaskDown[k]);
+    }
+
+    return attacks;
+} // end of sliderAttacksScalar
+
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNEL
+#include <immintrin.h>
+
+/***************************************************************
+ * sliderAttacksAVX2
+ * The same as above, with the four directions in one register.
+ * This is compiled for AVX2, regardless of the compiler options,
+ * so it must only be called, when the CPU supports it.
+ ***************************************************************/
+__attribute__((target("avx2")))
+static bitboard_t sliderAttacksAVX2(bitboard_t rooks, bitboard_t bishops, bitboard_t occupied)
+{
+    const __m256i s1 = _mm256_set_epi64x(7, 9, 1, 8);
+    const __m256i s2 = _mm256_add_epi64(s1, s1);
+    const __m256i s4 = _mm256_add_epi64(s2, s2);
+
+    const __m256i maskUp   = _mm256_loadu_si256((const __m256i *) fillMaskUp);
+    const __m256i maskDown = _mm256_loadu_si256((const __m256i *) fillMaskDown);
+
+    __m256i gen   = _mm256_set_epi64x(bishops, bishops, rooks, rooks);
+    __m256i empty = _mm256_set1_epi64x(~occupied);
+
+    // Up the board
+    __m256i g = gen;
+    __m256i p = _mm256_and_si256(empty, maskUp);
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_sllv_epi64(g, s1)));
+    p = _mm256_and_si256(p, _mm256_sllv_epi64(p, s1));
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_sllv_epi64(g, s2)));
+    p = _mm256_and_si256(p, _mm256_sllv_epi64(p, s2));
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_sllv_epi64(g, s4)));
+    __m256i attacks = _mm256_and_si256(_mm256_sllv_epi64(g, s1), maskUp);
+
+    // Down the board
+    g = gen;
+    p = _mm256_and_si256(empty, maskDown);
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_srlv_epi64(g, s1)));
+    p = _mm256_and_si256(p, _mm256_srlv_epi64(p, s1));
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_srlv_epi64(g, s2)));
+    p = _mm256_and_si256(p, _mm256_srlv_epi64(p, s2));
+    g = _mm256_or_si256(g, _mm256_and_si256(p, _mm256_srlv_epi64(g, s4)));
+    attacks = _mm256_or_si256(attacks, _mm256_and_si256(_mm256_srlv_epi64(g, s1), maskDown));
+
+    // Combine the four lanes.
+    __m128i a = _mm_or_si128(_mm256_castsi256_si128(attacks), _mm256_extracti128_si256(attacks, 1));
+    a = _mm_or_si128(a, _mm_unpackhi_epi64(a, a));
+
+    bitboard_t result;
+    _mm_storel_epi64((__m128i *) &result, a);
+    return result;
+} // end of sliderAttacksAVX2
+#endif
+
+bitboard_t (*sliderAttacks)(bitboard_t, bitboard_t, bitboard_t) = sliderAttacksScalar;
+const char *sliderAttacksName = "scalar";
+
+
+#ifdef HAVE_AVX2_KERNEL
+/***************************************************************
+ * checkSliderAttacks
+ * Compares a slider attack function with the magic bitboards, for
+ * random sets of sliders and random occupancies.
+ * Returns true, if they agree.
+ ***************************************************************/
+static bool checkSliderAttacks(bitboard_t (*kernel)(bitboard_t, bitboard_t, bitboard_t))
+{
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+
+    for (int i=0; i<4096; ++i)
+    {
+        // A cheap xorshift generator. The occupancy is about a
+        // quarter full, and some of the pieces are sliders.
+        bitboard_t random[4];
+        for (int k=0; k<4; ++k)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            random[k] = seed;
+        }
+        bitboard_t occupied = random[0] & random[1];
+        bitboard_t rooks    = occupied & random[2] & ~random[3];
+        bitboard_t bishops  = occupied & random[3] & ~random[2];
+
+        bitboard_t expected = 0;
+        for (bitboard_t bb = rooks; bb; )
+            expected |= rookAttacks(bb_pop(bb), occupied);
+        for (bitboard_t bb = bishops; bb; )
+            expected |= bishopAttacks(bb_pop(bb), occupied);
+
+        if (kernel(rooks, bishops, occupied) != expected)
+            return false;
+    }
+    return true;
+} // end of checkSliderAttacks
+#endif
+
+
+/***************************************************************
+ * useScalarSliderAttacks
+ ***************************************************************/
+void useScalarSliderAttacks()
+{
+    sliderAttacks     = sliderAttacksScalar;
+    sliderAttacksName = "scalar";
+} // end of useScalarSliderAttacks
+
+
+/***************************************************************
+ * initBitboards
+ ***************************************************************/
+static void initBitboards()
+{
+    static const int knightSteps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2},
+                                          {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+    static const int kingSteps[8][2]   = {{1, 0}, {1, 1}, {0, 1}, {-1, 1},
+                                          {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+
+    for (int sq=0; sq<64; ++sq)
+    {
+        knightAttacks[sq] = 0;
+        kingAttacks[sq]   = 0;
+        for (int k=0; k<8; ++k)
+        {
+            int sq2 = step(sq, knightSteps[k][0], knightSteps[k][1]);
+            if (sq2 >= 0)
+                knightAttacks[sq] |= bb_square(sq2);
+
+            sq2 = step(sq, kingSteps[k][0], kingSteps[k][1]);
+            if (sq2 >= 0)
+                kingAttacks[sq] |= bb_square(sq2);
+        }
+
+        pawnAttacks[WHITE][sq] = 0;
+        pawnAttacks[BLACK][sq] = 0;
+        for (int dcol=-1; dcol<=1; dcol+=2)
+        {
+            int sq2 = step(sq, dcol, 1);
+            if (sq2 >= 0)
+                pawnAttacks[WHITE][sq] |= bb_square(sq2);
+
+            sq2 = step(sq, dcol, -1);
+            if (sq2 >= 0)
+                pawnAttacks[BLACK][sq] |= bb_square(sq2);
+        }
+    }
+
+    initMagics(rookMagics,   rookTable,   rookDirs,   rookMagicNumbers);
+    initMagics(bishopMagics, bishopTable, bishopDirs, bishopMagicNumbers);
+
+    for (int sq=0; sq<64; ++sq)
+    {
+        bishopRays[sq] = bishopAttacks(sq, 0);
+        rookRays[sq]   = rookAttacks(sq, 0);
+    }
+
+#ifdef HAVE_AVX2_KERNEL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        // The kernel must agree with the magic bitboards.
+        // Otherwise the scalar version is kept.
+        if (checkSliderAttacks(sliderAttacksAVX2))
+        {
+            sliderAttacks     = sliderAttacksAVX2;
+            sliderAttacksName = "AVX2";
+        }
+        else
+        {
+            sliderAttacksName = "scalar (AVX2 failed the self-check)";
+        }
+    }
+#endif
+
+    for (int sq1=0; sq1<64; ++sq1)
+    {
+        for (int sq2=0; sq2<64; ++sq2)
+        {
+            betweenBB[sq1][sq2] = 0;
+            lineBB[sq1][sq2]    = 0;
+
+            if (sq1 == sq2)
+                continue;
+
+            if (rookRays[sq1] & bb_square(sq2))
+            {
+                betweenBB[sq1][sq2] = rookAttacks(sq1, bb_square(sq2)) & rookAttacks(sq2, bb_square(sq1));
+                lineBB[sq1][sq2]    = (rookRays[sq1] & rookRays[sq2])
+                                    | bb_square(sq1) | bb_square(sq2);
+            }
+            else if (bishopRays[sq1] & bb_square(sq2))
+            {
+                betweenBB[sq1][sq2] = bishopAttacks(sq1, bb_square(sq2)) & bishopAttacks(sq2, bb_square(sq1));
+                lineBB[sq1][sq2]    = (bishopRays[sq1] & bishopRays[sq2])
+                                    | bb_square(sq1) | bb_square(sq2);
+            }
+        }
+    }
+} // end of initBitboards
+
+
+// The tables are filled in before main() is called.
+static struct CBitboardInit
+{
+    CBitboardInit() {initBitboards();}
+} bitboardInit;
+
@@ -0,0 +1,127 @@
+#ifndef _BITBOARD_H_
+#define _BITBOARD_H_
+
+#include <stdint.h>
+
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
+/***************************************************************
+ * A bitboard is a set of squares, stored in a 64-bit integer.
+ * Bit number n corresponds to square number n, i.e.
+ * bit 0 is A1, bit 7 is H1, bit 56 is A8, and bit 63 is H8.
+ ***************************************************************/
+typedef uint64_t bitboard_t;
+
+// Colour index used for tables that differ between the two sides.
+enum
+{
+    WHITE = 0,
+    BLACK = 1
+};
+
+const bitboard_t FILE_A = 0x0101010101010101ULL;
+const bitboard_t FILE_H = 0x8080808080808080ULL;
+const bitboard_t RANK_1 = 0x00000000000000FFULL;
+const bitboard_t RANK_3 = 0x0000000000FF0000ULL;
+const bitboard_t RANK_6 = 0x0000FF0000000000ULL;
+const bitboard_t RANK_8 = 0xFF00000000000000ULL;
+
+inline bitboard_t bb_square(int sq)        {return 1ULL << sq;}
+inline int        bb_count(bitboard_t bb)  {return __builtin_popcountll(bb);}
+inline int        bb_first(bitboard_t bb)  {return __builtin_ctzll(bb);}
+
+// Moves every square of the set by 'Dir', i.e. up the board for
+// positive directions. Squares moved off the board are lost, but
+// the caller must remove those that would wrap around a file edge.
+template <int Dir>
+inline bitboard_t bb_shift(bitboard_t bb)
+{
+    return (Dir > 0) ? (bb << (Dir & 63)) : (bb >> (-Dir & 63));
+}
+
+// Returns the lowest square in the set, and removes it from the set.
+inline int bb_pop(bitboard_t& bb)
+{
+    int sq = bb_first(bb);
+    bb &= bb - 1;
+    return sq;
+}
+
+// Precomputed attacks of the non-sliding pieces.
+extern bitboard_t knightAttacks[64];
+extern bitboard_t kingAttacks[64];
+extern bitboard_t pawnAttacks[2][64]; // Squares attacked by a pawn of the given colour.
+
+// Squares attacked by a bishop or a rook on an empty board, i.e. the
+// squares it could ever attack. If none of the enemy sliders is on
+// such a square, the attack table need not be looked up at all.
+extern bitboard_t bishopRays[64];
+extern bitboard_t rookRays[64];
+
+// Squares strictly between two squares on the same line, and the entire
+// line through two squares. Both are empty, if the squares are not aligned.
+extern bitboard_t betweenBB[64][64];
+extern bitboard_t lineBB[64][64];
+
+/***************************************************************
+ * Sliding pieces use "fancy" magic bitboards:
+ * The relevant occupancy (i.e. excluding the board edges) is
+ * mapped to an index into a table of precomputed attack sets.
+ * With USE_PEXT the index is calculated directly with the BMI2
+ * instruction, and the magic multiplier is unused.
+ ***************************************************************/
+typedef struct
+{
+    bitboard_t  mask;     // Relevant occupancy squares
+    bitboard_t  magic;    // Magic multiplier
+    bitboard_t *attacks;  // Pointer into shared attack table
+    int         shift;    // 64 - number of bits in mask
+} t_magic;
+
+extern t_magic rookMagics[64];
+extern t_magic bishopMagics[64];
+
+inline unsigned int magic_index(const t_magic& m, bitboard_t occupied)
+{
+#ifdef USE_PEXT
+    return _pext_u64(occupied, m.mask);
+#else
+    return ((occupied & m.mask) * m.magic) >> m.shift;
+#endif
+}
+
+inline bitboard_t rookAttacks(int sq, bitboard_t occupied)
+{
+    const t_magic& m = rookMagics[sq];
+    return m.attacks[magic_index(m, occupied)];
+}
+
+inline bitboard_t bishopAttacks(int sq, bitboard_t occupied)
+{
+    const t_magic& m = bishopMagics[sq];
+    return m.attacks[magic_index(m, occupied)];
+}
+
+inline bitboard_t queenAttacks(int sq, bitboard_t occupied)
+{
+    return rookAttacks(sq, occupied) | bishopAttacks(sq, occupied);
+}
+
+/***************************************************************
+ * All squares attacked by a set of rooks and a set of bishops
+ * (queens belong to both sets). The attacks are calculated with
+ * Kogge-Stone occluded fills, one direction per 64-bit lane, so
+ * all the sliders of one side are handled at once, without a loop.
+ * The AVX2 version is selected at startup, if the CPU supports it,
+ * and checked against the magic bitboards.
+ ***************************************************************/
+extern bitboard_t (*sliderAttacks)(bitboard_t rooks, bitboard_t bishops, bitboard_t occupied);
+extern const char *sliderAttacksName;
+
+// Selects the portable version, e.g. to test it on an AVX2 machine.
+void useScalarSliderAttacks();
+
+#endif // _BITBOARD_H_
+
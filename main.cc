@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <vector>
 
 #include "CBoard.h"
 #include "CPerft.h"
@@ -28,9 +29,20 @@ int main(int argc, char **argv)
     CBoard board;
     AI ai(board);
 
+    // The last "position" command, split into the initial position and
+    // the moves, and the board it resulted in. See "position" below.
+    std::string lastBase;
+    std::string lastMoves;
+    CBoard      lastBoard;
+
+    // The hash keys of all positions in the game, for the detection
+    // of repetitions. The last one is the current position.
+    std::vector<uint64_t> history(1, board.hashKey());
+    std::vector<uint64_t> lastHistory;
+
     int c;
 
-    while ((c = getopt(argc, argv, "t:f:s:p:h")) != -1)
+    while ((c = getopt(argc, argv, "t:f:s:p:H:Sh")) != -1)
     {
         switch (c)
         {
@@ -72,9 +84,14 @@ int main(int argc, char **argv)
                            {
                                std::cout << "Error reading from FEN" << std::endl;
                            }
+                           history.assign(1, board.hashKey());
                        }
                        break;
 
+            case 'H' : ai.setHashSize(strtoul(optarg, NULL, 10)); break;
+
+            case 'S' : useScalarSliderAttacks(); break;
+
             case 'h' :
             default : {
                           std::cout << "Options:" << std::endl;
@@ -82,6 +99,8 @@ int main(int argc, char **argv)
                           std::cout << "-s <file> : Run search on test suite" << std::endl;
                           std::cout << "-p <file> : Run performance test on test suite" << std::endl;
                           std::cout << "-f <file> : Read initial position from FEN file" << std::endl;
+                          std::cout << "-H <MB>   : Size of transposition table" << std::endl;
+                          std::cout << "-S        : Use scalar slider attacks, even with AVX2" << std::endl;
                           std::cout << "-h        : Show this message" << std::endl;
                           exit(1);
                       }
@@ -114,6 +133,11 @@ int main(int argc, char **argv)
 #define DEF_XSTR(x) DEF_STR(x)
             std::cout << "id name " << DEF_XSTR(NAME) << std::endl;
             std::cout << "id author MJ" << std::endl;
+            std::cout << "option name Hash type spin default " << HASH_SIZE_DEFAULT
+                      << " min " << HASH_SIZE_MIN << " max " << HASH_SIZE_MAX << std::endl;
+            std::cout << "option name Clear Hash type button" << std::endl;
+            std::cout << "info string Slider attacks: " << sliderAttacksName << std::endl;
+            std::cout << "info string Hash table: " << ai.hashPages() << std::endl;
             std::cout << "uciok" << std::endl;
             uciMode = true;
         }
@@ -121,29 +145,67 @@ int main(int argc, char **argv)
         {
             std::cout << "readyok" << std::endl;
         }
+        if (str.compare(0, 15, "setoption name ") == 0)
+        {
+            std::string option = str.substr(15);
+            if (option.compare(0, 11, "Hash value ") == 0)
+            {
+                size_t size = ai.setHashSize(strtoul(option.c_str()+11, NULL, 10));
+                std::cout << "info string Hash " << size << " MB, " << ai.hashPages() << std::endl;
+            }
+            else if (option == "Clear Hash")
+            {
+                ai.clearHash();
+            }
+        }
         if (str == "ucinewgame")
         {
             board.newGame();
+            history.assign(1, board.hashKey());
         }
         if (str.compare(0, 9, "position ") == 0)
         {
-            if (str.compare(9, 9, "startpos ") == 0)
+            // Split the command into the initial position and the moves.
+            size_t pos = str.find("moves ");
+            std::string base  = str.substr(0, pos);
+            std::string moves = (pos != std::string::npos) ? str.substr(pos+6) : "";
+            base.erase(base.find_last_not_of(' ') + 1);
+
+            // If the GUI just appended some moves to the previous command,
+            // only the new moves are played on the previous board.
+            size_t done = lastMoves.size();
+            if (base == lastBase && moves.compare(0, done, lastMoves) == 0
+                    && (done == 0 || moves.size() == done || moves[done] == ' '))
             {
-                board.newGame();
-            } else if (str.compare(9, 4, "fen ") == 0)
+                board   = lastBoard;
+                history = lastHistory;
+            }
+            else
             {
-                if (board.read_from_fen(str.substr(13).c_str()))
+                done = 0;
+                lastBase.clear();
+                if (str.compare(9, 8, "startpos") == 0)
+                {
+                    board.newGame();
+                } else if (str.compare(9, 4, "fen ") == 0)
                 {
-                    std::cout << "Error reading from FEN" << std::endl;
+                    if (board.read_from_fen(str.substr(13).c_str()))
+                    {
+                        // The board and its history are left as they were,
+                        // and the moves are not played.
+                        std::cout << "Error reading from FEN" << std::endl;
+                        continue;
+                    }
                 }
+                history.assign(1, board.hashKey());
             }
 
-            size_t pos = str.find("moves ");
             if (pos != std::string::npos)
             {
-                pos += 6;
                 CMove move;
-                const char *p = str.c_str()+pos;
+                const char *p = moves.c_str() + done;
+                while (*p == ' ')
+                    ++p;
                 std::cout << p << std::endl;
                 while ((p = move.FromString(p)) != NULL)
                 {
@@ -152,11 +214,19 @@ int main(int argc, char **argv)
                         std::cout << "Invalid move " << move << std::endl;
                         std::cout << board << std::endl;
                         std::cout << p << std::endl;
+                        moves.clear();
+                        base.clear();
                         break;
                     }
                     board.make_move(move);
+                    history.push_back(board.hashKey());
                 }
             }
+
+            lastBase    = base;
+            lastMoves   = moves;
+            lastBoard   = board;
+            lastHistory = history;
         }
 
         if (str.compare(0, 6, "perft ") == 0)
@@ -185,20 +255,15 @@ int main(int argc, char **argv)
                 continue; // Go back to beginning
             }
 
-            if (board.IsMoveValid(move))
+            if (!board.IsMoveValid(move))
             {
-                board.make_move(move);
-                bool check = board.isOtherKingInCheck();
-                board.undo_move(move);
-                if (check)
-                {
-                    std::cout << "You are in CHECK. Play another move." << std::endl;
-                    continue;
-                }
-
-                std::cout << "You move : " << move << std::endl;
-                board.make_move(move);
+                std::cout << "Illegal move. Play another move." << std::endl;
+                continue;
             }
+
+            std::cout << "You move : " << move << std::endl;
+            board.make_move(move);
+            history.push_back(board.hashKey());
         } // end of "move "
 
         if (str.compare(0, 2, "go") == 0)
@@ -241,12 +306,13 @@ int main(int argc, char **argv)
                     ++p;
             } // end of while
 
+            ai.setHistory(history);
             CMove best_move = ai.find_best_move(wtime_ms, btime_ms, movesToGo);
 
             if (!best_move.Valid())
             {
                 // Oops. No legal move was found
-                bool check = board.isOtherKingInCheck();
+                bool check = board.isKingInCheck();
                 if (check)
                 {
                     std::cout << "I am checkmated. YOU WON!" << std::endl;
@@ -261,23 +327,14 @@ int main(int argc, char **argv)
             std::cout << "bestmove " << best_move << std::endl;
 
             board.make_move(best_move);
+            history.push_back(board.hashKey());
         } // end of "go"
 
         if (str == "show")
         {
             CMoveList moves;
             board.find_legal_moves(moves);
-            for (unsigned int i=0; i<moves.size(); ++i)
-            {
-                const CMove & move = moves[i];
-                board.make_move(move);
-                if (!board.isOtherKingInCheck())
-                {
-                    std::cout << move << " ";
-                }
-                board.undo_move(move);
-            }
-            std::cout << std::endl;
+            std::cout << moves << std::endl;
         }
     } // end of while (true)
 
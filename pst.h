@@ -0,0 +1,44 @@
+#ifndef _PST_H_
+#define _PST_H_
+
+#include <stdint.h>
+
+/***************************************************************
+ * Piece-square tables.
+ * Each piece gets a bonus or penalty depending on its square.
+ * There is one table for the middlegame and one for the endgame.
+ * The two scores are blended according to the game phase, which
+ * is calculated from the pieces left on the board (a "tapered"
+ * evaluation).
+ *
+ * The values are in centipawns, and do not include the material.
+ * The tables are seen from White, and are indexed by piece type
+ * minus one. Black uses the same tables, mirrored vertically.
+ ***************************************************************/
+
+#define PHASE_MAX 24 // All the pieces on the board
+
+extern const int16_t pstMg[6][64];
+extern const int16_t pstEg[6][64];
+extern const uint8_t phaseWeight[7]; // Indexed by piece type (EM - WK)
+
+// The tables are written with the 8th row first, so that they
+// look like the board. The piece is one of WP - WK or BP - BK,
+// and the score is positive for White.
+inline int pst_mg(int piece, int sq)
+{
+    return (piece > 0) ? pstMg[piece-1][sq^56] : -pstMg[-piece-1][sq];
+}
+
+inline int pst_eg(int piece, int sq)
+{
+    return (piece > 0) ? pstEg[piece-1][sq^56] : -pstEg[-piece-1][sq];
+}
+
+inline int pst_phase(int piece)
+{
+    return phaseWeight[(piece > 0) ? piece : -piece];
+}
+
+#endif // _PST_H_
+
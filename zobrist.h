@@ -0,0 +1,52 @@
+#ifndef _ZOBRIST_H_
+#define _ZOBRIST_H_
+
+#include <stdint.h>
+
+/***************************************************************
+ * Zobrist hashing.
+ * The hash key of a position is the XOR of a random number for
+ * each piece on each square, for each castling right, for the
+ * en-passant file, and for the side to move.
+ * Since XOR is its own inverse, the key can be updated
+ * incrementally when a move is made.
+ ***************************************************************/
+
+#define PIECE_INDEX     0
+#define CASTLE_INDEX    (12*64)
+#define ENPASSANT_INDEX (CASTLE_INDEX + 4)
+#define SIDE_INDEX      (ENPASSANT_INDEX + 8)
+
+extern const uint64_t hashVals[];
+
+// The piece is one of WP - WK or BP - BK.
+inline uint64_t zobrist_piece(int piece, int sq)
+{
+    int pix = (piece > 0) ? piece - 1 : piece + 12;
+    return hashVals[PIECE_INDEX + pix*64 + sq];
+}
+
+// The XOR of the keys of all the castling rights in the mask.
+inline uint64_t zobrist_castle(int castleRights)
+{
+    uint64_t key = 0;
+    for (int i=0; i<4; ++i)
+    {
+        if (castleRights & (1<<i))
+            key ^= hashVals[CASTLE_INDEX + i];
+    }
+    return key;
+}
+
+inline uint64_t zobrist_enpassant(int sq)
+{
+    return hashVals[ENPASSANT_INDEX + sq%8];
+}
+
+inline uint64_t zobrist_side()
+{
+    return hashVals[SIDE_INDEX];
+}
+
+#endif // _ZOBRIST_H_
+